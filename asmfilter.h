@@ -0,0 +1,92 @@
+#ifndef _ASMFILTER_H_
+#define _ASMFILTER_H_
+
+/**
+ * @file asmfilter.h
+ * @brief Hand scheduled x86-64 kernel running one section of one channel over a chunk of samples
+ * @details The x86-64 counterpart of the ARM inline assembly in optimization/assembly. The state of the section stays in
+ *          registers for the whole chunk and the recursion is ordered so only one multiply waits on the previous
+ *          output. The output is bit for bit that of butterworthSectionApply. Only uses the x86-64 baseline, so it is
+ *          compiled into every x86-64 build and chosen at run time through cpuFeatures().
+ */
+
+/*
+(NOTE: 1):  The ARM variant adds the five 64 bit products with adds/adc and shifts the sum once. That rounds once
+            instead of five times, so its output differs from the portable filter in the last raw bit, which the
+            feedback then carries on. Here each product is shifted on its own like fixedpoint_mul, sar on the full 64
+            bit imul result, and the shifted products are summed in one 64 bit register. Only the low 32 bits of the sum
+            are kept, which are the same as the wrapping 32 bit sum of the truncated products.
+
+(NOTE: 2):  Per sample four of the products only depend on inputs and the output two samples back, so they are issued
+            first and overlap with the previous sample. The critical path is a1 * y1: imul, sar, sub and the sign
+            extension of the new output.
+
+(NOTE: 3):  BMI2 has no signed multiply (mulx is unsigned) and sarx only saves the count register of a variable shift,
+            the shift here is the constant FRACTIONAL_BITS, so a BMI2 variant would run the same instructions.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fixedpoint.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ASMFILTER_X86_64 1
+
+#define ASM_SECTION_COEFFICIENTS 5 // b0, b1, b2, a1, a2, sign extended to 64 bits
+#define ASM_SECTION_STATE 4        // x1, x2, y1, y2, sign extended to 64 bits
+
+// Run numSamples fixed point samples through one section in place, (NOTE: 1)
+static inline void asmSectionFilter(const int64_t *coefficients, int64_t *state, int32_t *work, size_t numSamples)
+{
+    int64_t x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+    int64_t x, sum, product;
+    if (numSamples == 0)
+    {
+        return;
+    }
+
+    // (NOTE: 2)
+    __asm__ __volatile__(
+        "1:\n\t"
+        "movslq (%[work]), %[x]\n\t"
+        "movq %[x2], %[sum]\n\t"
+        "imulq 16(%[c]), %[sum]\n\t" // b2 * x2
+        "movq %[y2], %[product]\n\t"
+        "imulq 32(%[c]), %[product]\n\t" // a2 * y2
+        "sarq %[shift], %[sum]\n\t"
+        "sarq %[shift], %[product]\n\t"
+        "subq %[product], %[sum]\n\t"
+        "movq %[x1], %[product]\n\t"
+        "imulq 8(%[c]), %[product]\n\t" // b1 * x1
+        "sarq %[shift], %[product]\n\t"
+        "addq %[product], %[sum]\n\t"
+        "movq %[x], %[product]\n\t"
+        "imulq (%[c]), %[product]\n\t" // b0 * x
+        "sarq %[shift], %[product]\n\t"
+        "addq %[product], %[sum]\n\t"
+        "movq %[x1], %[x2]\n\t"
+        "movq %[x], %[x1]\n\t"
+        "movq %[y1], %[product]\n\t"
+        "imulq 24(%[c]), %[product]\n\t" // a1 * y1, the only product waiting on the previous output
+        "sarq %[shift], %[product]\n\t"
+        "subq %[product], %[sum]\n\t"
+        "movq %[y1], %[y2]\n\t"
+        "movslq %k[sum], %[y1]\n\t"
+        "movl %k[sum], (%[work])\n\t"
+        "addq $4, %[work]\n\t"
+        "decq %[n]\n\t"
+        "jnz 1b\n\t"
+        : [x1] "+r"(x1), [x2] "+r"(x2), [y1] "+r"(y1), [y2] "+r"(y2), [work] "+r"(work), [n] "+r"(numSamples), [x] "=&r"(x),
+          [sum] "=&r"(sum), [product] "=&r"(product)
+        : [c] "r"(coefficients), [shift] "i"(FRACTIONAL_BITS)
+        : "cc", "memory");
+
+    state[0] = x1;
+    state[1] = x2;
+    state[2] = y1;
+    state[3] = y2;
+}
+#endif
+
+#endif // _ASMFILTER_H_
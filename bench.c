@@ -0,0 +1,302 @@
+/*
+    Microbenchmark of the filter kernels on samples in memory, built and run by make bench.
+    Every kernel variant filters a signal of each length in blocks of each size, after a warm-up, many times over. The
+    median and 99th percentile of the repetitions are reported in nanoseconds per sample, without process start up,
+    file I/O or parsing in the measurement.
+*/
+
+#define BUTTERWORTH_LIBRARY // The filter without the command line tool, whose kernels are static
+#include "butterworth.c"
+
+#include "phasestats.h"
+
+#define BENCH_SAMPLES_PER_MEASUREMENT (1u << 22) // Samples filtered per measurement, sets the repetitions of long signals
+#define BENCH_MIN_REPETITIONS 11
+#define BENCH_DEFAULT_REPETITIONS 201
+#define BENCH_MAX_SIZES 8
+#define BENCH_SEED 0x2545F491u
+#define BENCH_HOST_FEATURES (~0u) // Whatever the host has
+#define BENCH_FILTERS 16384        // Filters of the many filter variants, whose state no longer fits in L1
+
+// One way of filtering the signal
+typedef struct BenchVariant
+{
+    const char *name;
+    FilterKernel kernel;
+    unsigned features; // CPU features the kernel may use, see cpuFeaturesRestrict, skipped if the host lacks any of them
+    unsigned channels; // Interleaved channels filtered together
+    int perSample;     // Call butterworthFilterApply for every sample instead of running a block kernel
+    unsigned filters;  // Filters of one design taking turns on the blocks of one channel, a ButterworthBank for TDF-II
+} BenchVariant;
+
+static const BenchVariant variants[] = {
+    {"apply", FILTER_KERNEL_SCALAR, 0, 1, 1, 1},
+    {"scalar", FILTER_KERNEL_SCALAR, 0, 1, 0, 1},
+    {"tdf2", FILTER_KERNEL_TDF2, 0, 1, 0, 1},
+    {"lookahead-portable", FILTER_KERNEL_LOOKAHEAD, 0, 1, 0, 1},
+    {"lookahead-avx2", FILTER_KERNEL_LOOKAHEAD, CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2, 1, 0, 1},
+    {"lookahead-avx512", FILTER_KERNEL_LOOKAHEAD, CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2 | CPU_FEATURE_AVX512, 1, 0, 1},
+    {"auto-portable", FILTER_KERNEL_AUTO, 0, 1, 0, 1},
+    {"auto-x86-64", FILTER_KERNEL_AUTO, CPU_FEATURE_X86_64, 1, 0, 1},
+    {"int16", FILTER_KERNEL_INT16, BENCH_HOST_FEATURES, 1, 0, 1},
+    {"auto-portable", FILTER_KERNEL_AUTO, 0, 16, 0, 1},
+    {"auto-avx2", FILTER_KERNEL_AUTO, CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2, 16, 0, 1},
+    {"auto-avx512", FILTER_KERNEL_AUTO, CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2 | CPU_FEATURE_AVX512, 16, 0, 1},
+    {"int16", FILTER_KERNEL_INT16, BENCH_HOST_FEATURES, 16, 0, 1},
+    {"df1-filters", FILTER_KERNEL_SCALAR, 0, 1, 0, BENCH_FILTERS},
+    {"tdf2-bank", FILTER_KERNEL_TDF2, 0, 1, 0, BENCH_FILTERS},
+};
+
+// Keeps the compiler from dropping the output of the kernels
+static volatile uint16_t benchSink;
+
+// Half scale noise around the middle of the range, within the range the scalar kernel is exact for
+static void benchSignal(uint16_t *samples, size_t numSamples)
+{
+    uint32_t state = BENCH_SEED;
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        samples[i] = (uint16_t)(16384 + (state >> 17));
+    }
+}
+
+// Filter the whole signal once in blocks of blockFrames frames, returns the nanoseconds per sample
+static double benchRun(const BenchVariant *variant, ButterworthFilter *filters, ButterworthBank *bank, const uint16_t *input,
+                       uint16_t *output, size_t numFrames, size_t blockFrames)
+{
+    unsigned channels = variant->channels;
+    size_t turn = 0;
+    uint64_t start = statsNow();
+    for (size_t frame = 0; frame < numFrames; frame += blockFrames)
+    {
+        size_t n = numFrames - frame < blockFrames ? numFrames - frame : blockFrames;
+        const uint16_t *in = input + frame * channels;
+        uint16_t *out = output + frame * channels;
+        if (variant->filters > 1)
+        {
+            // The next filter takes the block
+            turn = turn + 1 < variant->filters ? turn + 1 : 0;
+            if (bank != NULL)
+            {
+                butterworthBankProcessBlock(bank, turn, in, out, n);
+            }
+            else
+            {
+                butterworthFilterChannels(&filters[turn], 1, in, out, n);
+            }
+        }
+        else if (variant->perSample)
+        {
+            // The original loop, one sample through every section at a time
+            for (size_t i = 0; i < n; i++)
+            {
+                out[i] = fixedpoint_to_uint16(butterworthFilterApply(&filters[0], fixedpoint_from_int(in[i])));
+            }
+        }
+        else
+        {
+            butterworthFilterChannels(filters, channels, in, out, n * channels);
+        }
+    }
+    uint64_t elapsed = statsNow() - start;
+    benchSink = output[numFrames * channels - 1];
+    return (double)elapsed / (double)(numFrames * channels);
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Parse a comma separated list of positive sizes, returns the number of sizes or -1 if the list is malformed
+static int parseSizes(const char *text, size_t *sizes)
+{
+    int count = 0;
+    while (count < BENCH_MAX_SIZES)
+    {
+        char *end;
+        unsigned long value = strtoul(text, &end, 10);
+        if (end == text || value == 0)
+        {
+            return -1;
+        }
+        sizes[count++] = value;
+        if (*end == '\0')
+        {
+            return count;
+        }
+        if (*end != ',')
+        {
+            return -1;
+        }
+        text = end + 1;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    double samplingRate = SAMPLING_RATE;
+    double cutoffFrequency = CUTOFF_FREQUENCY;
+    unsigned order = 8;
+    unsigned repetitions = BENCH_DEFAULT_REPETITIONS;
+    const char *kernelName = NULL;
+    size_t lengths[BENCH_MAX_SIZES] = {4096, 65536, 1048576};
+    size_t blocks[BENCH_MAX_SIZES] = {64, 1024, 16384};
+    int numLengths = 3, numBlocks = 3;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--order") == 0) && i + 1 < argc)
+        {
+            order = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--sample-rate") == 0) && i + 1 < argc)
+        {
+            samplingRate = strtod(argv[++i], NULL);
+        }
+        else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cutoff") == 0) && i + 1 < argc)
+        {
+            cutoffFrequency = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            kernelName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+        {
+            repetitions = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--lengths") == 0 && i + 1 < argc)
+        {
+            numLengths = parseSizes(argv[++i], lengths);
+        }
+        else if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc)
+        {
+            numBlocks = parseSizes(argv[++i], blocks);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+            fprintf(stderr, "  -r, --sample-rate <hz>  Sampling rate of the design (default: %d)\n", SAMPLING_RATE);
+            fprintf(stderr, "  -c, --cutoff <hz>       Cutoff frequency of the design (default: %d)\n", CUTOFF_FREQUENCY);
+            fprintf(stderr, "  -n, --order <n>         Order of the design, %d to %d (default: 8)\n", MIN_ORDER, MAX_ORDER);
+            fprintf(stderr, "      --kernel <name>     Only run the variants of this name, e.g. scalar or auto-avx2\n");
+            fprintf(stderr, "      --repetitions <n>   Most timed runs of each measurement (default: %d)\n", BENCH_DEFAULT_REPETITIONS);
+            fprintf(stderr, "      --lengths <n,...>   Signal lengths in frames (default: 4096,65536,1048576)\n");
+            fprintf(stderr, "      --blocks <n,...>    Block sizes in frames (default: 64,1024,16384)\n");
+            return 1;
+        }
+    }
+    if (numLengths < 0 || numBlocks < 0 || repetitions < 1)
+    {
+        fprintf(stderr, "Lengths, block sizes and repetitions must be positive, at most %d sizes each\n", BENCH_MAX_SIZES);
+        return 1;
+    }
+    if (!butterworthFilterDesignable(samplingRate, cutoffFrequency, order))
+    {
+        fprintf(stderr, "A cutoff of %g Hz at %g Hz and order %u can not be represented\n", cutoffFrequency, samplingRate, order);
+        return 1;
+    }
+
+    ButterworthFilter design;
+    butterworthFilterInit(&design, samplingRate, cutoffFrequency, order);
+    static FilterLookahead lookahead;
+    butterworthLookaheadInit(&lookahead, &design);
+    size_t maxFilters = BENCH_FILTERS > SAMPLE_MAX_CHANNELS ? BENCH_FILTERS : SAMPLE_MAX_CHANNELS;
+    ButterworthFilter *filters = NULL;
+    if (posix_memalign((void **)&filters, FILTER_CACHE_LINE, maxFilters * sizeof(ButterworthFilter)) != 0)
+    {
+        fprintf(stderr, "Failed to allocate the filters\n");
+        return 1;
+    }
+
+    size_t maxSamples = 0;
+    for (int l = 0; l < numLengths; l++)
+    {
+        maxSamples = lengths[l] > maxSamples ? lengths[l] : maxSamples;
+    }
+    maxSamples *= SIMD_INT16_LANES; // The widest variant
+    uint16_t *input = (uint16_t *)malloc(maxSamples * sizeof(uint16_t));
+    uint16_t *output = (uint16_t *)malloc(maxSamples * sizeof(uint16_t));
+    double *times = (double *)malloc((repetitions < BENCH_MIN_REPETITIONS ? BENCH_MIN_REPETITIONS : repetitions) * sizeof(double));
+    if (input == NULL || output == NULL || times == NULL)
+    {
+        fprintf(stderr, "Failed to allocate sample buffers\n");
+        return 1;
+    }
+    benchSignal(input, maxSamples);
+
+    unsigned hostFeatures = cpuFeatures();
+    printf("# %g Hz cutoff at %g Hz, order %u, CPU features 0x%x\n", cutoffFrequency, samplingRate, order, hostFeatures);
+    printf("%-18s %8s %9s %7s %6s %14s %14s\n", "kernel", "channels", "frames", "block", "runs", "median ns/smp", "p99 ns/smp");
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+    {
+        const BenchVariant *variant = &variants[v];
+        if ((kernelName != NULL && strcmp(kernelName, variant->name) != 0) ||
+            (variant->features != BENCH_HOST_FEATURES && (variant->features & ~hostFeatures) != 0))
+        {
+            continue;
+        }
+        if (variant->kernel == FILTER_KERNEL_INT16 && !butterworthFilterInt16Fits(&design))
+        {
+            printf("%-18s %8u  does not fit the design\n", variant->name, variant->channels);
+            continue;
+        }
+        cpuFeaturesRestrict(variant->features);
+        ButterworthBank *bank = NULL;
+        if (variant->filters > 1 && variant->kernel == FILTER_KERNEL_TDF2)
+        {
+            bank = butterworthBankCreate(samplingRate, cutoffFrequency, order, variant->filters);
+            if (bank == NULL)
+            {
+                fprintf(stderr, "Failed to allocate the filter bank\n");
+                return 1;
+            }
+        }
+
+        for (int l = 0; l < numLengths; l++)
+        {
+            // Long signals get fewer repetitions, short ones enough to stand out from the clock
+            size_t numSamples = lengths[l] * variant->channels;
+            unsigned runs = (unsigned)(BENCH_SAMPLES_PER_MEASUREMENT / numSamples);
+            runs = runs > repetitions ? repetitions : runs < BENCH_MIN_REPETITIONS ? BENCH_MIN_REPETITIONS : runs;
+            for (int b = 0; b < numBlocks; b++)
+            {
+                for (unsigned channel = 0; channel < variant->channels * variant->filters; channel++)
+                {
+                    filters[channel] = design;
+                    filters[channel].kernel = variant->kernel;
+                    filters[channel].lookahead = &lookahead;
+                }
+                if (bank != NULL)
+                {
+                    butterworthBankReset(bank);
+                }
+                // Warm up the caches, branch predictors and clock frequency before timing
+                for (unsigned run = 0; run < runs / 10 + 1; run++)
+                {
+                    benchRun(variant, filters, bank, input, output, lengths[l], blocks[b]);
+                }
+                for (unsigned run = 0; run < runs; run++)
+                {
+                    times[run] = benchRun(variant, filters, bank, input, output, lengths[l], blocks[b]);
+                }
+                qsort(times, runs, sizeof(double), compareDoubles);
+                size_t p99 = (size_t)(0.99 * (runs - 1) + 0.5);
+                printf("%-18s %8u %9zu %7zu %6u %14.3f %14.3f\n", variant->name, variant->channels, lengths[l], blocks[b],
+                       runs, times[runs / 2], times[p99]);
+                fflush(stdout);
+            }
+        }
+        butterworthBankDestroy(bank);
+    }
+    cpuFeaturesRestrict(~0u);
+
+    free(filters);
+    free(input);
+    free(output);
+    free(times);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef _BLOCKRING_H_
+#define _BLOCKRING_H_
+
+/**
+ * @file blockring.h
+ * @brief Lock free single producer, single consumer ring of sample blocks
+ * @details Each slot owns a fixed sample buffer. The producer fills the slot at head and publishes it, the consumer
+ *          processes the slot at tail and hands it back, so buffers are recycled without any allocation or locking.
+ *          Only one thread may produce and one thread may consume.
+ */
+
+/*
+(NOTE: 1):  head and tail only ever increase, the slot is the counter modulo the (power of two) size. The ring is full
+            when head - tail == size and empty when head == tail. Each counter is written by one thread only.
+
+(NOTE: 2):  Publishing uses release stores and checking uses acquire loads, so the contents of a slot are visible to
+            the other thread before the counter that hands it over.
+
+(NOTE: 3):  The counters are kept on separate cache lines so the two threads do not invalidate each other's line on
+            every update.
+*/
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BLOCKRING_CACHE_LINE 64
+
+// One block of samples. A count of 0 marks the end of the stream and -1 an error, both are the last block sent.
+typedef struct SampleBlock
+{
+    uint16_t *samples;
+    long count;
+} SampleBlock;
+
+typedef struct BlockRing
+{
+    SampleBlock *slots;
+    size_t mask; // Number of slots - 1, (NOTE: 1)
+    char padHead[BLOCKRING_CACHE_LINE];
+    size_t head; // Next slot to fill, written by the producer, (NOTE: 3)
+    char padTail[BLOCKRING_CACHE_LINE];
+    size_t tail; // Next slot to process, written by the consumer
+    char padEnd[BLOCKRING_CACHE_LINE];
+} BlockRing;
+
+// Release the slots and their buffers
+static inline void blockRingFree(BlockRing *ring)
+{
+    if (ring->slots != NULL)
+    {
+        for (size_t i = 0; i <= ring->mask; i++)
+        {
+            free(ring->slots[i].samples);
+        }
+    }
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+// Allocate a ring of numSlots slots (a power of two) holding blockSamples samples each. Returns 0 on success, -1 on failure.
+static inline int blockRingInit(BlockRing *ring, size_t numSlots, size_t blockSamples)
+{
+    ring->slots = (SampleBlock *)calloc(numSlots, sizeof(SampleBlock));
+    ring->mask = numSlots - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    if (ring->slots == NULL)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < numSlots; i++)
+    {
+        ring->slots[i].samples = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+        if (ring->slots[i].samples == NULL)
+        {
+            blockRingFree(ring); // The slots are zeroed, the unallocated buffers free as NULL
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Wait for a free slot to fill. Returns NULL if *abort is set while waiting.
+static inline SampleBlock *blockRingAcquire(BlockRing *ring, const int *abort)
+{
+    while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask)
+    {
+        if (__atomic_load_n(abort, __ATOMIC_RELAXED))
+        {
+            return NULL;
+        }
+        sched_yield();
+    }
+    return &ring->slots[ring->head & ring->mask];
+}
+
+// Hand the slot returned by blockRingAcquire to the consumer, (NOTE: 2)
+static inline void blockRingPublish(BlockRing *ring)
+{
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// Wait for a filled slot. Returns NULL if *abort is set while waiting.
+static inline SampleBlock *blockRingPeek(BlockRing *ring, const int *abort)
+{
+    while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail)
+    {
+        if (__atomic_load_n(abort, __ATOMIC_RELAXED))
+        {
+            return NULL;
+        }
+        sched_yield();
+    }
+    return &ring->slots[ring->tail & ring->mask];
+}
+
+// Hand the slot returned by blockRingPeek back to the producer
+static inline void blockRingRelease(BlockRing *ring)
+{
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+#endif // _BLOCKRING_H_
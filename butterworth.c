@@ -6,90 +6,355 @@ REFERENCES:
 [5]     https://sourceforge.net/projects/fixedptc/
 */
 
+#define _POSIX_C_SOURCE 200809L // pthreads
+
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "asmfilter.h"
+#include "blockring.h"
+#include "coeffcache.h"
+#include "cpufeatures.h"
 #include "fixedpoint.h"
+#include "libbutterworth.h"
+#include "phasestats.h"
+#include "sampleio.h"
+#include "simdfilter.h"
+#include "specialized.h"
+#include "uringio.h"
 
 // Constants for Butterworth filter
-#define ORDER 2
-#define SAMPLING_RATE 22 * 1000   // Hertz [0, 65535]
-#define CUTOFF_FREQUENCY 2 * 1000 // Hertz [0, 65535], must be less than half the sampling rate
+#define ORDER 2                   // Default, [MIN_ORDER, MAX_ORDER]
+#define MIN_ORDER 2
+#define MAX_ORDER 16
+#define SAMPLING_RATE 22 * 1000   // Default, Hertz [0, 65535]
+#define CUTOFF_FREQUENCY 2 * 1000 // Default, Hertz [0, 65535], must be less than half the sampling rate
+#define PI 3.14159265358979323846
+#define MAX_SECTIONS ((MAX_ORDER + 1) / 2)
+#define SECTION_COEFFICIENTS 5 // b0, b1, b2, a1, a2 of a section as stored in the coefficient cache, a0 is always 1.0
+#define FILTER_CACHE_LINE 64
+#define FILTER_CHUNK 256 // Samples run through one section before moving to the next, (NOTE: 2)
+#define LOOKAHEAD_BLOCK SIMD_LOOKAHEAD_BLOCK           // Outputs of a section computed at once, (NOTE: 4)
+#define LOOKAHEAD_COLUMNS (LOOKAHEAD_BLOCK + 4)        // Inputs of a look-ahead block, the block and x1, x2, y1, y2
+#define LOOKAHEAD_GAIN_SAMPLES (1 << 16)               // Impulse response summed for the deviation bound, (NOTE: 5)
+#define PARALLEL_MAX_THREADS 64                        // Chunks of one channel filtered at once, (NOTE: 7)
+#define PARALLEL_MIN_CHUNK (1 << 16)                   // Fewer samples per chunk are not worth a thread
+#define PARALLEL_STATE_MAX (4 * MAX_SECTIONS)          // State words of a cascade, x1, x2, y1, y2 of every section
+#define PARALLEL_CHECKPOINTS 20                        // States kept of each chunk for the fix-up, (NOTE: 7)
+#define ZERO_PHASE_PADDING(order) (3 * ((order) + 1))  // Samples of odd extension at each end, (NOTE: 8)
 
-// Structure to hold Butterworth filter coefficients
-typedef struct FilterCoefficients
+// Numerator b0 (x + c1 x1 + c2 x2) of a section as one multiply, exact for whole sample inputs, (NOTE: 9)
+#define FOLDED_NUMERATOR(b0, x, c1, x1, c2, x2) \
+    (fixedpoint_t)((((long_fixedpoint_t)(x) + (c1) * (long_fixedpoint_t)(x1) + (c2) * (long_fixedpoint_t)(x2)) * (b0)) >> FRACTIONAL_BITS)
+
+/*
+(NOTE: 1):  An order N filter is a cascade of N / 2 second order sections (biquads), plus a first order section when N
+            is odd. Section k has the analog poles s^2 + 2 sin((2k + 1) pi / 2N) s + 1, the bilinear transform turns it
+            into the same difference equation as the original single biquad. Sections run from the lowest Q to the
+            highest, so the resonant sections see a signal that has already been attenuated near the cutoff.
+
+(NOTE: 2):  A block is filtered a chunk at a time: the chunk goes through the first section, then the second, and so on.
+            Each section's loop only touches its own coefficients and state and a chunk sized work buffer, all of which
+            stay in L1. Samples stay in fixed point between sections and are only converted back at the end.
+
+(NOTE: 3):  With 8 or more channels the SIMD kernel filters groups of 16 (AVX-512) or 8 (AVX2) channels in the lanes of a
+            vector register, see simdfilter.h. The coefficients and state of a group are gathered into lane order at the
+            start of every block and scattered back at the end, so each channel keeps its own ButterworthFilter and the
+            kernel can be switched between blocks. Channels left over after the last whole group use the scalar path.
+
+(NOTE: 4):  The recursion of a section waits on the multiplies of the previous output, so one channel can not use SIMD.
+            The look-ahead kernel computes LOOKAHEAD_BLOCK outputs at once instead: unrolling the recursion over a block
+            makes every output a fixed linear combination of the block's inputs and the state (x1, x2, y1, y2) at its
+            start. The combinations are the columns of a matrix built from the section's impulse and state responses,
+            quantized to 2^-shift with shift as large as the 64 bit sums allow. Only the last two outputs of a block
+            feed the next one. Leftover samples at the end of a chunk run the scalar recursion on the same state.
+            The matrix product is 20 multiply-adds per output, more than the recursion's five, so it only pays off as
+            8 (AVX-512) or 4 (AVX2) 64 bit sums at once. Without AVX2 the kernel runs the direct form recursion.
+
+(NOTE: 5):  The look-ahead kernel rounds differently from the scalar one. Per sample the scalar section truncates five
+            products, an error within (-3, 2) raw LSBs (2^-15), and the look-ahead section truncates once and carries
+            the quantization of LOOKAHEAD_COLUMNS matrix entries times inputs below 2^31, 1 + 20 * 2^(30 - shift). Both
+            errors recirculate through the feedback, which amplifies them by at most the L1 norm of the impulse response
+            of 1 / A(z). A difference between the inputs of a section grows by at most the L1 norm of its own impulse
+            response. Summed over the cascade this bounds the raw difference D of the outputs, which differ by at most
+            floor(D / 2^16) + 1 once converted to 16 bits. --verify checks the bound against the scalar filter. The bound
+            assumes no section output wraps around 32 bits, which makes the scalar output meaningless as well (e.g. a
+            full scale input near a high cutoff of a 16th order filter).
+
+(NOTE: 6):  The scalar kernel is Direct Form I: four state words per section, all four stored every sample. Transposed
+            Direct Form II computes y = b0 x + s1, s1 = b1 x - a1 y + s2, s2 = b2 x - a2 y with two state words, which
+            the kernel keeps in locals for a whole chunk. They are stored in x1 and x2 of the section, y1 and y2 stay
+            zero, so a filter keeps the kernel it started with. Each product is still truncated on its own and the state
+            words only hold sums of truncated products, so y is the same sum as in Direct Form I in another order. 32 bit
+            addition wraps and is associative, so the output is bit exact with the scalar kernel, overflow included.
+            A ButterworthBank of the library holds many filters of one design with the coefficients once and only the
+            Tdf2State of each section per filter, 8 bytes instead of the 36 of a FilterSection, so the state of four
+            times as many filters fits in the same cache.
+
+(NOTE: 7):  One long channel is filtered in parallel by splitting it into a chunk per thread. Every chunk but the first is
+            filtered from the steady state for its first sample, the state the filter would have after a long constant
+            input, so near full scale it starts without the transient a zero state would give, which can wrap around
+            the 32 bit range. Its output then differs from the true one only by the decaying response to the difference
+            of the two start states. Each chunk keeps its state at checkpoints, the first where that response from any
+            32 bit state has decayed below half a raw LSB (A^L with A the one sample state transition of the cascade),
+            each further one twice as far. Once all chunks are done, the true end state is handed from chunk to chunk on
+            one thread: each chunk is filtered again from the true state at its start until the state meets the one at
+            a checkpoint. From there on both runs are the same, so the rest of the output and the end state are already
+            right and the output is bit for bit the sequential one, wrapped samples and all. A chunk that never meets a
+            checkpoint is filtered again to the end, which is still exact. The state usually meets the first one or two
+            checkpoints, a few hundred to a few thousand samples into the chunk. With an overlap the fix-up is skipped:
+            each chunk instead starts that many samples early and discards them, which is only exact when the overlap
+            is long compared to the decay of the filter.
+
+(NOTE: 8):  Zero phase filtering runs the filter forward and then backward in time, like scipy.signal.filtfilt: the
+            signal is extended at both ends by 3 (order + 1) samples of odd extension (2 x[0] - x[k], clamped to the
+            sample range), each pass starts from the steady state for its first sample, and the extension is cut off
+            again. The samples stay in fixed point between the passes and are converted to 16 bits once, so the output
+            has the same scale as a single pass. With threads the forward pass stays on the calling thread, and as soon
+            as it is past the end of a chunk, the backward pass of that chunk starts on a thread of its own while the
+            forward pass moves on, from the steady state for the chunk's last forward output. The backward passes keep
+            checkpoints and are then fixed up from the last chunk to the first as in (NOTE: 7), the start of a chunk's
+            backward pass being the end of the chunk, which needs a copy of the forward output of every chunk but the
+            last. Chunk ends and checkpoints are multiples of FILTER_CHUNK from the end of the channel, where a
+            backward pass over the whole channel starts each chunk of samples, so the look-ahead kernel, which rounds by
+            block, sees the same blocks as on one thread, and the output is bit for bit that of one thread.
+
+(NOTE: 9):  The numerator of a low-pass biquad is b0 (1 + 2 z^-1 + z^-2), so b0 x + b1 x1 + b2 x2 folds to a single
+            multiply b0 (x + 2 x1 + x2). In the first section x, x1 and x2 are whole samples, so each of the three
+            products is exact and the folded product is the same number, also when the sum wraps around 32 bits. Later
+            sections see fractional inputs and keep their three truncated products. The fold is only used while x1 and x2
+            of the first section are whole, which a state restored by --threads need not be. specialized.h holds one
+            design as an X-macro, generated by --emit-kernel (make specialize), and the kernel built from it has every
+            coefficient as an immediate and the state of all sections in locals. It is used automatically whenever a
+            filter's coefficients are the compiled ones.
+
+(NOTE: 10): The kernels for every instruction set are compiled into each x86-64 binary, the SIMD ones with target
+            attributes, and the automatic kernel picks one per call from cpuFeatures(), detected once with cpuid. So a
+            binary built for the x86-64 baseline (make ARCH=x86-64) runs the AVX-512 kernels on hosts that have them and
+            the AVX2 or plain x86-64 ones elsewhere. Every variant is bit exact with the portable scalar kernel, which
+            --verify compares against, and --cpu caps the features used.
+
+(NOTE: 11): The int16 kernel runs the cascade in Q1.15 (fixedpoint.h, NOTE 5), see simdfilter.h for the SIMD form. The
+            coefficients keep their 15 fractional bits, so the transfer function is the scalar one, but the samples
+            and state lose the 15 bits below the sample LSB. The input is centered on zero and halved, the headroom
+            the scalar output has as well (fixedpoint_to_uint16 halves), and every product rounds. The state is kept in
+            x1, x2, y1, y2 in the units of the scalar kernel: the Q1.15 value times 2, plus the level an input of 32768
+            reaches at that point of the cascade (its DC gain G so far). So a zero state means a signal that was zero,
+            as for the scalar kernel, and the output is the Q1.15 result plus 32767 + 16384 G. Each product is within
+            half a Q1.15 LSB, which is one output LSB, so the bound of (NOTE: 5) becomes 2.5 output LSBs per section
+            and sample through the feedback gain, plus half an LSB at the input and one at the output. Low cutoffs have
+            small b0 and a large feedback gain, for those the bound shows that 16 bits are not enough. Designs with a
+            coefficient outside [-1, 1) after taking out the whole part of a1, e.g. a cutoff near half the sampling rate,
+            can not use the kernel. The tool refuses them, and a filter set to the kernel anyway runs the Q17.15 one.
+
+(NOTE: 12): make lib builds everything above the command line tool into libbutterworth.a and libbutterworth.so, with
+            only the functions of libbutterworth.h exported from the shared library. A handle is one ButterworthFilter
+            with the automatic kernel, so a block goes through butterworthFilterBlock like one channel of the tool: the
+            single biquad and each section of the cascade run over the whole block with their state in locals (or in
+            registers with the x86-64 kernel) and store it back once, instead of through butterworthFilterApply, which
+            loads and stores the state of every section for every sample.
+*/
+
+// Implementation used to filter a block, chosen with --kernel
+typedef enum FilterKernel
+{
+    FILTER_KERNEL_AUTO,      // Fastest bit exact kernel the CPU supports, SIMD for groups of 8 or more channels, (NOTE: 10)
+    FILTER_KERNEL_SCALAR,    // One channel and one sample at a time in portable C, the reference of --verify
+    FILTER_KERNEL_LOOKAHEAD, // Blocks of LOOKAHEAD_BLOCK samples of one channel at a time, (NOTE: 4)
+    FILTER_KERNEL_TDF2,      // Transposed Direct Form II, one channel and one sample at a time, (NOTE: 6)
+    FILTER_KERNEL_INT16,     // Q1.15 in 16 bits, 16 channels per AVX2 register, (NOTE: 11)
+} FilterKernel;
+
+// One second order section, a first order section has b2 = a2 = 0
+typedef struct FilterSection
 {
     // Numerator coefficients
     fixedpoint_t b0, b1, b2;
-    // Denominator coefficients
-    fixedpoint_t a0, a1, a2;
+    // Denominator coefficients, a0 is normalized to 1.0
+    fixedpoint_t a1, a2;
 
     // Previous input
     fixedpoint_t x1, x2;
 
     // Previous output
     fixedpoint_t y1, y2;
-} ButterworthFilter;
+} FilterSection;
 
-// Function to initialize Butterworth filter
-void butterworthFilterInit(ButterworthFilter *filter)
+// State of one section in Transposed Direct Form II, (NOTE: 6)
+typedef struct Tdf2State
 {
-    // TODO: Switch to a lookup table rather than a calculated value for the specific case
-    // double lambda = 1.0 / tan(M_PI * CUTOFF_FREQUENCY / SAMPLING_RATE);
-    fixedpoint_t lambda = fixedpoint_from_real(3.40568723888925); // TODO: Hardcoded the value for now
+    fixedpoint_t s1, s2;
+} Tdf2State;
 
-#ifdef DEBUG
-    printf("lambda:\t%s\n", fixedpoint_str(lambda));
-#endif
+// Look-ahead matrix of one section, (NOTE: 4). Column c is the response of the block's outputs to its input c.
+typedef struct LookaheadSection
+{
+    int64_t columns[LOOKAHEAD_COLUMNS][LOOKAHEAD_BLOCK] __attribute__((aligned(FILTER_CACHE_LINE)));
+    unsigned shift; // Fractional bits of the columns
+} LookaheadSection;
 
-    // Calculate the coefficients
-    // All of these are adjusted so that a0 is normalized to 1.0, a0 is calculated first and then used to scale all the other coefficients.
-    // These coefficients are usually divided by a0 but thats slow so instead 1/a0 is calculated and multiplied.
-    // double inv_a0 = 1.0 / (pow(lambda, 2) + sqrt(2.0) * lambda + 1.0);
+// Look-ahead matrices of every section, shared read only by all the channels of a design
+typedef struct FilterLookahead
+{
+    LookaheadSection sections[MAX_SECTIONS];
+} FilterLookahead;
+
+// Structure to hold the Butterworth filter sections, (NOTE: 1)
+// The sections are one contiguous array starting on a cache line
+typedef struct FilterCoefficients
+{
+    FilterSection sections[MAX_SECTIONS] __attribute__((aligned(FILTER_CACHE_LINE)));
+    unsigned numSections;
+    unsigned order;
+    FilterKernel kernel;
+    const FilterLookahead *lookahead; // Matrices of the look-ahead kernel, NULL until butterworthLookaheadInit
+} ButterworthFilter;
+
+// Initialize one section for the damping d (the s coefficient of its analog poles), or a first order section if d is 0
+static void butterworthSectionInit(FilterSection *section, fixedpoint_t lambda, fixedpoint_t d)
+{
     fixedpoint_t lambda_squared = fixedpoint_mul(lambda, lambda);
-    fixedpoint_t sqrt2_lambda = fixedpoint_mul(FIXEDPOINT_SQRT2, lambda);
-    fixedpoint_t a0 = lambda_squared + sqrt2_lambda + FIXEDPOINT_ONE;
-    fixedpoint_t inv_a0 = fixedpoint_div(FIXEDPOINT_ONE, a0);
+
+    if (d == FIXEDPOINT_ZERO)
+    {
+        // a0 = lambda + 1.0, b = [1, 1] / a0, a1 = (1.0 - lambda) / a0
+        fixedpoint_t inv_a0 = fixedpoint_div(FIXEDPOINT_ONE, lambda + FIXEDPOINT_ONE);
+        section->b0 = inv_a0;
+        section->b1 = inv_a0;
+        section->b2 = FIXEDPOINT_ZERO;
+        section->a1 = fixedpoint_mul(FIXEDPOINT_ONE - lambda, inv_a0);
+        section->a2 = FIXEDPOINT_ZERO;
+    }
+    else
+    {
+        // All of these are adjusted so that a0 is normalized to 1.0, a0 is calculated first and then used to scale all the other coefficients.
+        // These coefficients are usually divided by a0 but thats slow so instead 1/a0 is calculated and multiplied.
+        // double inv_a0 = 1.0 / (pow(lambda, 2) + d * lambda + 1.0);
+        fixedpoint_t d_lambda = fixedpoint_mul(d, lambda);
+        fixedpoint_t a0 = lambda_squared + d_lambda + FIXEDPOINT_ONE;
+        fixedpoint_t inv_a0 = fixedpoint_div(FIXEDPOINT_ONE, a0);
 
 #ifdef DEBUG
-    printf("inv_a0:\t%s\n", fixedpoint_str(inv_a0));
+        printf("inv_a0:\t%s\n", fixedpoint_str(inv_a0));
 #endif
 
-    // Calculate the coefficients:
-    filter->a0 = FIXEDPOINT_ONE; // Due to the normalizing around a0, this is always 1.0
-    // a1 = (-2.0 * pow(lambda, 2) + 2.0) * inv_a0;
-    filter->a1 = fixedpoint_mul((fixedpoint_mul(fixedpoint_from_int(-2), lambda_squared) + FIXEDPOINT_TWO), inv_a0);
-    // a2 = (pow(lambda, 2) - sqrt(2.0) * lambda + 1.0) * inv_a0;
-    filter->a2 = fixedpoint_mul((lambda_squared - sqrt2_lambda + FIXEDPOINT_ONE), inv_a0);
+        // a1 = (-2.0 * pow(lambda, 2) + 2.0) * inv_a0;
+        section->a1 = fixedpoint_mul((fixedpoint_mul(fixedpoint_from_int(-2), lambda_squared) + FIXEDPOINT_TWO), inv_a0);
+        // a2 = (pow(lambda, 2) - d * lambda + 1.0) * inv_a0;
+        section->a2 = fixedpoint_mul((lambda_squared - d_lambda + FIXEDPOINT_ONE), inv_a0);
 
-    // These are fixed for a second order Butterworth filter using the bilinear transform and adjusted using the value of a0.
-    filter->b0 = inv_a0;
-    // b1 = 2.0 * inv_a0
-    filter->b1 = fixedpoint_mul(FIXEDPOINT_TWO, inv_a0);
-    filter->b2 = inv_a0;
+        // These are fixed for a second order Butterworth section using the bilinear transform and adjusted using the value of a0.
+        section->b0 = inv_a0;
+        // b1 = 2.0 * inv_a0
+        section->b1 = fixedpoint_mul(FIXEDPOINT_TWO, inv_a0);
+        section->b2 = inv_a0;
+    }
 
 // Print the coefficients
 #ifdef DEBUG
-    printf("b0:\t%s\n", fixedpoint_str(filter->b0));
-    printf("b1:\t%s\n", fixedpoint_str(filter->b1));
-    printf("b2:\t%s\n", fixedpoint_str(filter->b2));
+    printf("b0:\t%s\n", fixedpoint_str(section->b0));
+    printf("b1:\t%s\n", fixedpoint_str(section->b1));
+    printf("b2:\t%s\n", fixedpoint_str(section->b2));
 
-    printf("a0:\t%s\n", fixedpoint_str(filter->a0));
-    printf("a1:\t%s\n", fixedpoint_str(filter->a1));
-    printf("a2:\t%s\n", fixedpoint_str(filter->a2));
+    printf("a1:\t%s\n", fixedpoint_str(section->a1));
+    printf("a2:\t%s\n", fixedpoint_str(section->a2));
 #endif
 
     // Initialize the previous input and output values to zero
-    filter->x1 = FIXEDPOINT_ZERO;
-    filter->x2 = FIXEDPOINT_ZERO;
-    filter->y1 = FIXEDPOINT_ZERO;
-    filter->y2 = FIXEDPOINT_ZERO;
+    section->x1 = FIXEDPOINT_ZERO;
+    section->x2 = FIXEDPOINT_ZERO;
+    section->y1 = FIXEDPOINT_ZERO;
+    section->y2 = FIXEDPOINT_ZERO;
 }
 
-// Function to apply Butterworth filter to a single input
-fixedpoint_t butterworthFilterApply(ButterworthFilter *f, fixedpoint_t input)
+// Damping of section k of an order N filter, (NOTE: 1). Sections are numbered from the lowest Q.
+static double butterworthSectionDamping(unsigned order, unsigned section)
+{
+    unsigned k = order / 2 - 1 - (section - order % 2);
+    return 2.0 * sin(PI * (2 * k + 1) / (2.0 * order));
+}
+
+// Function to initialize Butterworth filter for a sampling rate and cutoff frequency in Hertz
+// The cutoff must be below half the sampling rate, see butterworthFilterDesignable for the lower limit
+void butterworthFilterInit(ButterworthFilter *filter, double samplingRate, double cutoffFrequency, unsigned order)
+{
+    // Designs are cached by the caller (coeffcache.h), so this only runs once per configuration
+    // 3.40568723888925 for the default 2 kHz cutoff at 22 kHz
+    fixedpoint_t lambda = fixedpoint_from_real(1.0 / tan(PI * cutoffFrequency / samplingRate));
+
+#ifdef DEBUG
+    printf("lambda:\t%s\n", fixedpoint_str(lambda));
+#endif
+
+    memset(filter, 0, sizeof(*filter));
+    filter->order = order;
+    filter->numSections = (order + 1) / 2;
+    for (unsigned i = 0; i < filter->numSections; i++)
+    {
+        // An odd order starts with the first order section
+        int firstOrder = order % 2 == 1 && i == 0;
+        fixedpoint_t d = firstOrder ? FIXEDPOINT_ZERO : fixedpoint_from_real(butterworthSectionDamping(order, i));
+        butterworthSectionInit(&filter->sections[i], lambda, d);
+    }
+}
+
+// Check that a design fits the fixed point format: a0 = lambda^2 + d * lambda + 1 of every section must stay in range
+// and its inverse, b0, must not round to zero, which limits how low the cutoff can be relative to the sampling rate
+int butterworthFilterDesignable(double samplingRate, double cutoffFrequency, unsigned order)
+{
+    if (!(samplingRate > 0.0) || !(cutoffFrequency > 0.0) || !(cutoffFrequency < samplingRate / 2.0) || order < MIN_ORDER || order > MAX_ORDER)
+    {
+        return 0;
+    }
+    double lambda = 1.0 / tan(PI * cutoffFrequency / samplingRate);
+    double a0 = lambda * lambda + butterworthSectionDamping(order, order % 2) * lambda + 1.0; // Lowest Q has the largest a0
+    return a0 < (double)FIXEDPOINT_ONE / 2.0;
+}
+
+// Copy the coefficients to or from the order used by the coefficient cache, SECTION_COEFFICIENTS per section
+void butterworthFilterGetCoefficients(const ButterworthFilter *filter, int32_t *coefficients)
+{
+    for (unsigned i = 0; i < filter->numSections; i++)
+    {
+        const FilterSection *section = &filter->sections[i];
+        int32_t *c = &coefficients[i * SECTION_COEFFICIENTS];
+        c[0] = section->b0;
+        c[1] = section->b1;
+        c[2] = section->b2;
+        c[3] = section->a1;
+        c[4] = section->a2;
+    }
+}
+
+void butterworthFilterSetCoefficients(ButterworthFilter *filter, const int32_t *coefficients, unsigned order)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->order = order;
+    filter->numSections = (order + 1) / 2;
+    for (unsigned i = 0; i < filter->numSections; i++)
+    {
+        FilterSection *section = &filter->sections[i];
+        const int32_t *c = &coefficients[i * SECTION_COEFFICIENTS];
+        section->b0 = c[0];
+        section->b1 = c[1];
+        section->b2 = c[2];
+        section->a1 = c[3];
+        section->a2 = c[4];
+    }
+}
+
+// Function to apply one section of the Butterworth filter to a single input
+fixedpoint_t butterworthSectionApply(FilterSection *f, fixedpoint_t input)
 {
     // Calculate the output
     // output = (f->b0 * input + f->b1 * f->x1 + f->b2 * f->x2) - (f->a1 * f->y1 + f->a2 * f->y2);
@@ -105,6 +370,324 @@ fixedpoint_t butterworthFilterApply(ButterworthFilter *f, fixedpoint_t input)
     return output;
 }
 
+// Whether the numerator of a section folds into one multiply for its next input, (NOTE: 9)
+static int butterworthSectionFoldable(const FilterSection *f)
+{
+    return f->b1 == 2 * f->b0 && f->b2 == f->b0 && fixedpoint_fractional_part(f->x1) == 0 && fixedpoint_fractional_part(f->x2) == 0;
+}
+
+// Function to apply Butterworth filter to a single input, through every section
+fixedpoint_t butterworthFilterApply(ButterworthFilter *f, fixedpoint_t input)
+{
+    for (unsigned i = 0; i < f->numSections; i++)
+    {
+        input = butterworthSectionApply(&f->sections[i], input);
+    }
+    return input;
+}
+
+// Response of a section to n inputs from the state {x1, x2, y1, y2}, in exact arithmetic on its fixed point coefficients
+static void butterworthSectionResponse(const FilterSection *section, const double *input, const double *state, double *output, size_t n)
+{
+    double b0 = (double)section->b0 / FIXEDPOINT_ONE, b1 = (double)section->b1 / FIXEDPOINT_ONE, b2 = (double)section->b2 / FIXEDPOINT_ONE;
+    double a1 = (double)section->a1 / FIXEDPOINT_ONE, a2 = (double)section->a2 / FIXEDPOINT_ONE;
+    double x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+    for (size_t i = 0; i < n; i++)
+    {
+        double y = b0 * input[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = input[i];
+        y2 = y1;
+        y1 = y;
+        output[i] = y;
+    }
+}
+
+// Sum of the magnitudes of the impulse response of a section, or of its feedback 1 / A(z) alone: the most its output
+// moves for an input that moves by 1, (NOTE: 5)
+static double butterworthSectionGain(const FilterSection *section, int feedbackOnly)
+{
+    double b0 = feedbackOnly ? 1.0 : (double)section->b0 / FIXEDPOINT_ONE;
+    double b1 = feedbackOnly ? 0.0 : (double)section->b1 / FIXEDPOINT_ONE;
+    double b2 = feedbackOnly ? 0.0 : (double)section->b2 / FIXEDPOINT_ONE;
+    double a1 = (double)section->a1 / FIXEDPOINT_ONE, a2 = (double)section->a2 / FIXEDPOINT_ONE;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0, gain = 0.0;
+    for (size_t i = 0; i < LOOKAHEAD_GAIN_SAMPLES; i++)
+    {
+        double x = i == 0 ? 1.0 : 0.0;
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        gain += fabs(y);
+    }
+    return gain;
+}
+
+// Build the look-ahead matrices of every section of a designed filter, (NOTE: 4)
+void butterworthLookaheadInit(FilterLookahead *lookahead, const ButterworthFilter *filter)
+{
+    memset(lookahead, 0, sizeof(*lookahead));
+    for (unsigned s = 0; s < filter->numSections; s++)
+    {
+        const FilterSection *section = &filter->sections[s];
+        LookaheadSection *l = &lookahead->sections[s];
+
+        // Column c < LOOKAHEAD_BLOCK is the impulse response delayed by c, the rest respond to one unit of state
+        double response[LOOKAHEAD_COLUMNS][LOOKAHEAD_BLOCK];
+        double input[LOOKAHEAD_BLOCK] = {1.0};
+        double state[4] = {0.0};
+        butterworthSectionResponse(section, input, state, response[0], LOOKAHEAD_BLOCK);
+        for (unsigned c = 1; c < LOOKAHEAD_BLOCK; c++)
+        {
+            for (unsigned j = 0; j < LOOKAHEAD_BLOCK; j++)
+            {
+                response[c][j] = j < c ? 0.0 : response[0][j - c];
+            }
+        }
+        input[0] = 0.0;
+        for (unsigned k = 0; k < 4; k++)
+        {
+            state[k] = 1.0;
+            butterworthSectionResponse(section, input, state, response[LOOKAHEAD_BLOCK + k], LOOKAHEAD_BLOCK);
+            state[k] = 0.0;
+        }
+
+        // The largest shift that keeps every output's sum of products of 32 bit inputs below 2^62
+        double rowSum = 0.0;
+        for (unsigned j = 0; j < LOOKAHEAD_BLOCK; j++)
+        {
+            double sum = 0.0;
+            for (unsigned c = 0; c < LOOKAHEAD_COLUMNS; c++)
+            {
+                sum += fabs(response[c][j]);
+            }
+            rowSum = sum > rowSum ? sum : rowSum;
+        }
+        l->shift = 30;
+        while (l->shift > 0 && rowSum * ldexp(1.0, (int)l->shift) >= ldexp(1.0, 31))
+        {
+            l->shift--;
+        }
+        for (unsigned c = 0; c < LOOKAHEAD_COLUMNS; c++)
+        {
+            for (unsigned j = 0; j < LOOKAHEAD_BLOCK; j++)
+            {
+                l->columns[c][j] = (int64_t)floor(response[c][j] * ldexp(1.0, (int)l->shift) + 0.5);
+            }
+        }
+    }
+}
+
+#ifdef SIMDFILTER_AVX2
+// Run a chunk of fixed point samples through one section a block at a time, (NOTE: 4). Needs AVX2.
+static void butterworthLookaheadSection(const LookaheadSection *l, FilterSection *section, fixedpoint_t *work, size_t numSamples)
+{
+    unsigned features = cpuFeatures(); // (NOTE: 10)
+    size_t i = 0;
+    for (; i + LOOKAHEAD_BLOCK <= numSamples; i += LOOKAHEAD_BLOCK)
+    {
+        fixedpoint_t inputs[LOOKAHEAD_COLUMNS];
+        memcpy(inputs, &work[i], LOOKAHEAD_BLOCK * sizeof(fixedpoint_t));
+        inputs[LOOKAHEAD_BLOCK] = section->x1;
+        inputs[LOOKAHEAD_BLOCK + 1] = section->x2;
+        inputs[LOOKAHEAD_BLOCK + 2] = section->y1;
+        inputs[LOOKAHEAD_BLOCK + 3] = section->y2;
+
+        if (features & CPU_FEATURE_AVX512)
+        {
+            simdLookahead16(l->columns, inputs, LOOKAHEAD_COLUMNS, l->shift, &work[i]);
+        }
+        else
+        {
+            simdLookaheadAvx2(l->columns, inputs, LOOKAHEAD_COLUMNS, l->shift, &work[i]);
+        }
+
+        section->x1 = inputs[LOOKAHEAD_BLOCK - 1];
+        section->x2 = inputs[LOOKAHEAD_BLOCK - 2];
+        section->y1 = work[i + LOOKAHEAD_BLOCK - 1];
+        section->y2 = work[i + LOOKAHEAD_BLOCK - 2];
+    }
+    for (; i < numSamples; i++)
+    {
+        work[i] = butterworthSectionApply(section, work[i]);
+    }
+}
+#endif
+
+// Transposed Direct Form II on a chunk of fixed point samples, with the state in locals, (NOTE: 6)
+static void butterworthTdf2Section(const FilterSection *section, Tdf2State *state, fixedpoint_t *work, size_t numSamples)
+{
+    fixedpoint_t b0 = section->b0, b1 = section->b1, b2 = section->b2, a1 = section->a1, a2 = section->a2;
+    fixedpoint_t s1 = state->s1, s2 = state->s2;
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        fixedpoint_t x = work[i];
+        fixedpoint_t y = fixedpoint_mul(b0, x) + s1;
+        s1 = fixedpoint_mul(b1, x) - fixedpoint_mul(a1, y) + s2;
+        s2 = fixedpoint_mul(b2, x) - fixedpoint_mul(a2, y);
+        work[i] = y;
+    }
+    state->s1 = s1;
+    state->s2 = s2;
+}
+
+// One section of the int16 kernel, (NOTE: 11)
+typedef struct Int16Section
+{
+    q1_15_t b0, b1, b2, a1, a2; // a1 less its whole part
+    int wholeA1;
+    double inputLevel, outputLevel; // Raw scalar state of the input and output of the section for an input of 32768
+} Int16Section;
+
+typedef struct FilterInt16
+{
+    Int16Section sections[MAX_SECTIONS];
+    q1_15_t outputBias; // Added to the Q1.15 output, 32767 + 16384 G
+} FilterInt16;
+
+// Convert the coefficients of a filter to Q1.15. Returns 0 on success, -1 if a coefficient does not fit.
+static int butterworthInt16Init(const ButterworthFilter *f, FilterInt16 *q)
+{
+    double gain = 1.0;
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        const FilterSection *section = &f->sections[s];
+        Int16Section *qs = &q->sections[s];
+        qs->wholeA1 = (section->a1 + FIXEDPOINT_HALF) >> FRACTIONAL_BITS;
+        int32_t coefficients[SECTION_COEFFICIENTS] = {section->b0, section->b1, section->b2, section->a1 - qs->wholeA1 * FIXEDPOINT_ONE, section->a2};
+        for (unsigned c = 0; c < SECTION_COEFFICIENTS; c++)
+        {
+            if (coefficients[c] < q1_15_min || coefficients[c] > q1_15_max)
+            {
+                return -1;
+            }
+        }
+        qs->b0 = (q1_15_t)coefficients[0];
+        qs->b1 = (q1_15_t)coefficients[1];
+        qs->b2 = (q1_15_t)coefficients[2];
+        qs->a1 = (q1_15_t)coefficients[3];
+        qs->a2 = (q1_15_t)coefficients[4];
+
+        // DC gain of the cascade before and after the section
+        qs->inputLevel = ldexp(gain, 15 + FRACTIONAL_BITS);
+        gain *= (double)(section->b0 + section->b1 + section->b2) / (double)(FIXEDPOINT_ONE + section->a1 + section->a2);
+        qs->outputLevel = ldexp(gain, 15 + FRACTIONAL_BITS);
+    }
+    q->outputBias = (q1_15_t)(uint16_t)floor(32767.0 + 16384.0 * gain + 0.5);
+    return 0;
+}
+
+// Convert a state word between the raw scalar units and Q1.15 around level, (NOTE: 11)
+static q1_15_t butterworthInt16FromState(fixedpoint_t state, double level)
+{
+    return q1_15_saturate((int32_t)floor(((double)state - level) / (1 << (FRACTIONAL_BITS + 1)) + 0.5));
+}
+
+static fixedpoint_t butterworthInt16ToState(q1_15_t value, double level)
+{
+    return (fixedpoint_t)(uint32_t)((int64_t)value * (1 << (FRACTIONAL_BITS + 1)) + (int64_t)floor(level + 0.5));
+}
+
+// One sample through a Q1.15 section, the arithmetic of simdFilterInt16 for one lane
+static q1_15_t butterworthInt16SectionApply(const Int16Section *c, q1_15_t *state, q1_15_t x)
+{
+    // 16 bit sums wrap, (NOTE: 6) of simdfilter.h
+    int32_t sum = q1_15_mul_round(c->b0, x) + q1_15_mul_round(c->b1, state[0]) + q1_15_mul_round(c->b2, state[1]) -
+                  q1_15_mul_round(c->a1, state[2]) - q1_15_mul_round(c->a2, state[3]) - c->wholeA1 * state[2];
+    q1_15_t y = (q1_15_t)(uint16_t)sum;
+    state[1] = state[0];
+    state[0] = x;
+    state[3] = state[2];
+    state[2] = y;
+    return y;
+}
+
+// The int16 kernel on a block of samples stride apart, one channel at a time in portable C, (NOTE: 11)
+// Returns 0, or -1 without filtering anything if the coefficients do not fit Q1.15.
+static int butterworthInt16Strided(ButterworthFilter *f, const uint16_t *input, uint16_t *output, size_t numSamples, size_t stride,
+                                   uint16_t inputOffset, uint16_t outputOffset)
+{
+    FilterInt16 q;
+    q1_15_t state[MAX_SECTIONS][SIMD_SECTION_STATE];
+    if (butterworthInt16Init(f, &q) < 0)
+    {
+        return -1;
+    }
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        const FilterSection *section = &f->sections[s];
+        state[s][0] = butterworthInt16FromState(section->x1, q.sections[s].inputLevel);
+        state[s][1] = butterworthInt16FromState(section->x2, q.sections[s].inputLevel);
+        state[s][2] = butterworthInt16FromState(section->y1, q.sections[s].outputLevel);
+        state[s][3] = butterworthInt16FromState(section->y2, q.sections[s].outputLevel);
+    }
+
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        q1_15_t sample = (q1_15_t)((uint16_t)(input[i * stride] ^ inputOffset) ^ 0x8000) >> 1;
+        for (unsigned s = 0; s < f->numSections; s++)
+        {
+            sample = butterworthInt16SectionApply(&q.sections[s], state[s], sample);
+        }
+        output[i * stride] = (uint16_t)(sample + q.outputBias) ^ outputOffset;
+    }
+
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        FilterSection *section = &f->sections[s];
+        section->x1 = butterworthInt16ToState(state[s][0], q.sections[s].inputLevel);
+        section->x2 = butterworthInt16ToState(state[s][1], q.sections[s].inputLevel);
+        section->y1 = butterworthInt16ToState(state[s][2], q.sections[s].outputLevel);
+        section->y2 = butterworthInt16ToState(state[s][3], q.sections[s].outputLevel);
+    }
+    return 0;
+}
+
+// Whether a design can run the int16 kernel, (NOTE: 11)
+int butterworthFilterInt16Fits(const ButterworthFilter *f)
+{
+    FilterInt16 q;
+    return butterworthInt16Init(f, &q) == 0;
+}
+
+// Largest difference of a filter's output from the scalar kernel in output LSBs, 0 for the bit exact kernels, (NOTE: 5)
+unsigned butterworthFilterDeviationBound(const ButterworthFilter *f)
+{
+    if (f->kernel == FILTER_KERNEL_INT16 && butterworthFilterInt16Fits(f))
+    {
+        // Output LSBs, the input rounding of half an LSB and the scalar kernel's own rounding, (NOTE: 11)
+        double deviation = 0.5;
+        for (unsigned s = 0; s < f->numSections; s++)
+        {
+            const FilterSection *section = &f->sections[s];
+            deviation = butterworthSectionGain(section, 0) * deviation + (2.5 + 3.0 / 65536.0) * butterworthSectionGain(section, 1);
+        }
+        return (unsigned)floor(deviation) + 2;
+    }
+    if (f->kernel != FILTER_KERNEL_LOOKAHEAD)
+    {
+        return 0;
+    }
+
+    double deviation = 0.0; // Raw LSBs at the output of the cascade so far
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        // Rounding of the scalar kernel plus that of the look-ahead one, per sample
+        double rounding = 3.0 + 1.0 + LOOKAHEAD_COLUMNS * ldexp(1.0, 30 - (int)f->lookahead->sections[s].shift);
+        const FilterSection *section = &f->sections[s];
+        deviation = butterworthSectionGain(section, 0) * deviation + rounding * butterworthSectionGain(section, 1);
+    }
+    return (unsigned)floor(deviation / 65536.0) + 1;
+}
+
+// Whether a filter runs the original Direct Form I recursion of butterworthSectionApply
+static int butterworthFilterDirectForm(const ButterworthFilter *f)
+{
+    return f->kernel == FILTER_KERNEL_AUTO || f->kernel == FILTER_KERNEL_SCALAR;
+}
+
 uint16_t fixedpoint_to_uint16(fixedpoint_t input)
 {
     // Adjust the range from [0,65535] of the input to [-32727, 32727] of the output
@@ -119,85 +702,2643 @@ uint16_t fixedpoint_to_uint16(fixedpoint_t input)
     return fixedpoint_to_int(scaled);
 }
 
-int main(int argc, char *argv[])
+// The recursion of butterworthSectionApply on a chunk of fixed point samples, with the state in locals for the whole
+// chunk instead of loaded from and stored to the section every sample
+static void butterworthDirectFormSection(FilterSection *section, fixedpoint_t *work, size_t numSamples)
 {
-    printf("Applying Butterworth Filter\n");
-    if (argc < 3)
+    fixedpoint_t b0 = section->b0, b1 = section->b1, b2 = section->b2, a1 = section->a1, a2 = section->a2;
+    fixedpoint_t x1 = section->x1, x2 = section->x2, y1 = section->y1, y2 = section->y2;
+    for (size_t i = 0; i < numSamples; i++)
     {
-        printf("Usage: %s <input_file> <output_file>\n", argv[0]);
-        return 1;
+        fixedpoint_t x = work[i];
+        fixedpoint_t y = (fixedpoint_mul(b0, x) + fixedpoint_mul(b1, x1) + fixedpoint_mul(b2, x2)) - (fixedpoint_mul(a1, y1) + fixedpoint_mul(a2, y2));
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        work[i] = y;
     }
+    section->x1 = x1;
+    section->x2 = x2;
+    section->y1 = y1;
+    section->y2 = y2;
+}
 
-    FILE *inputFile = fopen(argv[1], "r");
-    FILE *outputFile = fopen(argv[2], "w");
+// butterworthDirectFormSection for whole sample inputs of a foldable section, bit exact with it, (NOTE: 9)
+static void butterworthFoldedSection(FilterSection *section, fixedpoint_t *work, size_t numSamples)
+{
+    fixedpoint_t b0 = section->b0, a1 = section->a1, a2 = section->a2;
+    fixedpoint_t x1 = section->x1, x2 = section->x2, y1 = section->y1, y2 = section->y2;
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        fixedpoint_t x = work[i];
+        fixedpoint_t y = FOLDED_NUMERATOR(b0, x, 2, x1, 1, x2) - (fixedpoint_mul(a1, y1) + fixedpoint_mul(a2, y2));
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        work[i] = y;
+    }
+    section->x1 = x1;
+    section->x2 = x2;
+    section->y1 = y1;
+    section->y2 = y2;
+}
 
-    if (inputFile == NULL || outputFile == NULL)
+// A single biquad from and to 16 bit samples stride apart, with the state in locals, folded if the section allows it
+static inline void butterworthBiquadStrided(FilterSection *section, int folded, const uint16_t *input, uint16_t *output, size_t numSamples,
+                                            size_t stride, uint16_t inputOffset, uint16_t outputOffset)
+{
+    fixedpoint_t b0 = section->b0, b1 = section->b1, b2 = section->b2, a1 = section->a1, a2 = section->a2;
+    fixedpoint_t x1 = section->x1, x2 = section->x2, y1 = section->y1, y2 = section->y2;
+    for (size_t i = 0; i < numSamples; i++)
     {
-        printf("Failed to open input or output file\n");
-        return 1;
+        fixedpoint_t x = fixedpoint_from_int((uint16_t)(input[i * stride] ^ inputOffset));
+        fixedpoint_t numerator = folded ? FOLDED_NUMERATOR(b0, x, 2, x1, 1, x2) : fixedpoint_mul(b0, x) + fixedpoint_mul(b1, x1) + fixedpoint_mul(b2, x2);
+        fixedpoint_t y = numerator - (fixedpoint_mul(a1, y1) + fixedpoint_mul(a2, y2));
+#ifdef DEBUG
+        printf("Input:\t%s\n", fixedpoint_str(x));
+        printf("Output:\t%s\n", fixedpoint_str(y));
+#endif
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        output[i * stride] = fixedpoint_to_uint16(y) ^ outputOffset;
     }
+    section->x1 = x1;
+    section->x2 = x2;
+    section->y1 = y1;
+    section->y2 = y2;
+}
 
-    // Count the number of lines in the input file
-    // TODO: Optimization: dont scan the file, instead apply as reading the file
-    size_t numSamples = 0;
-    int c;
-    while ((c = fgetc(inputFile)) != EOF)
+// Coefficients of the design compiled into the specialized kernel, in the order of butterworthFilterGetCoefficients
+#define SPECIALIZED_COEFFICIENTS(index, b0, b1, b2, a1, a2) b0, b1, b2, a1, a2,
+static const int32_t specializedCoefficients[] = {SPECIALIZED_SECTIONS(SPECIALIZED_COEFFICIENTS)};
+#define SPECIALIZED_NUM_SECTIONS (sizeof(specializedCoefficients) / sizeof(specializedCoefficients[0]) / SECTION_COEFFICIENTS)
+
+// Whether a filter can run the specialized kernel: its coefficients are the compiled ones, the first section's
+// numerator is a multiple of b0 and its state whole samples, (NOTE: 9)
+static int butterworthFilterSpecialized(const ButterworthFilter *f)
+{
+    if (!butterworthFilterDirectForm(f) || f->order != SPECIALIZED_ORDER || f->numSections != SPECIALIZED_NUM_SECTIONS)
     {
-        if (c == '\n')
-        {
-            numSamples++;
-        }
+        return 0;
     }
-    numSamples++; // Add one for the last line
-    // Reset the file pointer to the beginning of the file
-    fseek(inputFile, 0, SEEK_SET);
+    int32_t coefficients[MAX_SECTIONS * SECTION_COEFFICIENTS];
+    butterworthFilterGetCoefficients(f, coefficients);
+    const FilterSection *first = &f->sections[0];
+    return memcmp(coefficients, specializedCoefficients, sizeof(specializedCoefficients)) == 0 && first->b0 > 0 &&
+           first->b1 % first->b0 == 0 && first->b2 % first->b0 == 0 && fixedpoint_fractional_part(first->x1) == 0 &&
+           fixedpoint_fractional_part(first->x2) == 0;
+}
 
-    // Allocate memory for input and output buffers
-    fixedpoint_t *inputBuffer = (fixedpoint_t *)malloc(numSamples * sizeof(fixedpoint_t));
-    fixedpoint_t *outputBuffer = (fixedpoint_t *)malloc(numSamples * sizeof(fixedpoint_t));
+// The section of butterworthSectionApply with immediate coefficients, the first one folded, (NOTE: 9)
+#define SPECIALIZED_MUL(constant, value) (fixedpoint_t)(((long_fixedpoint_t)(constant) * (value)) >> FRACTIONAL_BITS)
+#define SPECIALIZED_LOAD(index, b0, b1, b2, a1, a2)                                                            \
+    fixedpoint_t x1_##index = f->sections[index].x1, x2_##index = f->sections[index].x2;                      \
+    fixedpoint_t y1_##index = f->sections[index].y1, y2_##index = f->sections[index].y2;
+#define SPECIALIZED_APPLY(index, b0, b1, b2, a1, a2)                                                           \
+    {                                                                                                          \
+        fixedpoint_t y = (index == 0 ? FOLDED_NUMERATOR(b0, sample, (b1) / (b0), x1_##index, (b2) / (b0), x2_##index) \
+                                     : SPECIALIZED_MUL(b0, sample) + SPECIALIZED_MUL(b1, x1_##index) +        \
+                                           SPECIALIZED_MUL(b2, x2_##index)) -                                  \
+                         (SPECIALIZED_MUL(a1, y1_##index) + SPECIALIZED_MUL(a2, y2_##index));                  \
+        x2_##index = x1_##index;                                                                               \
+        x1_##index = sample;                                                                                   \
+        y2_##index = y1_##index;                                                                               \
+        y1_##index = y;                                                                                        \
+        sample = y;                                                                                            \
+    }
+#define SPECIALIZED_STORE(index, b0, b1, b2, a1, a2)                                                           \
+    f->sections[index].x1 = x1_##index;                                                                        \
+    f->sections[index].x2 = x2_##index;                                                                        \
+    f->sections[index].y1 = y1_##index;                                                                        \
+    f->sections[index].y2 = y2_##index;
 
-    // Read input samples from file
-    uint16_t sample;
+// butterworthFilterStrided for the design in specialized.h, every section one sample at a time from locals
+static void butterworthFilterSpecializedStrided(ButterworthFilter *f, const uint16_t *input, uint16_t *output, size_t numSamples, size_t stride,
+                                                uint16_t inputOffset, uint16_t outputOffset)
+{
+    SPECIALIZED_SECTIONS(SPECIALIZED_LOAD)
     for (size_t i = 0; i < numSamples; i++)
     {
-        if (fscanf(inputFile, "%hu", &sample) != 1)
+        fixedpoint_t sample = fixedpoint_from_int((uint16_t)(input[i * stride] ^ inputOffset));
+        SPECIALIZED_SECTIONS(SPECIALIZED_APPLY)
+        output[i * stride] = fixedpoint_to_uint16(sample) ^ outputOffset;
+    }
+    SPECIALIZED_SECTIONS(SPECIALIZED_STORE)
+}
+
+#ifdef ASMFILTER_X86_64
+// Run a chunk of fixed point samples through one section with the x86-64 kernel, bit exact with butterworthSectionApply
+static void butterworthAsmSection(FilterSection *section, fixedpoint_t *work, size_t numSamples)
+{
+    int64_t coefficients[ASM_SECTION_COEFFICIENTS] = {section->b0, section->b1, section->b2, section->a1, section->a2};
+    int64_t state[ASM_SECTION_STATE] = {section->x1, section->x2, section->y1, section->y2};
+    asmSectionFilter(coefficients, state, work, numSamples);
+    section->x1 = (fixedpoint_t)state[0];
+    section->x2 = (fixedpoint_t)state[1];
+    section->y1 = (fixedpoint_t)state[2];
+    section->y2 = (fixedpoint_t)state[3];
+}
+#endif
+
+// Run a chunk of fixed point samples through the sections from first on in place, one section at a time, (NOTE: 2)
+static void butterworthFilterSections(ButterworthFilter *f, fixedpoint_t *work, size_t numSamples, unsigned first)
+{
+#ifdef ASMFILTER_X86_64
+    int useAsm = f->kernel == FILTER_KERNEL_AUTO && (cpuFeatures() & CPU_FEATURE_X86_64); // (NOTE: 10)
+#endif
+#ifdef SIMDFILTER_AVX2
+    int useLookahead = f->kernel == FILTER_KERNEL_LOOKAHEAD && (cpuFeatures() & CPU_FEATURE_AVX2); // (NOTE: 4)
+#endif
+    for (unsigned s = first; s < f->numSections; s++)
+    {
+        FilterSection *section = &f->sections[s];
+#ifdef SIMDFILTER_AVX2
+        if (useLookahead)
         {
-            printf("Error reading input sample at line %zu\n", i + 1);
-            return 1;
+            butterworthLookaheadSection(&f->lookahead->sections[s], section, work, numSamples);
+            continue;
         }
-        else
+#endif
+        if (f->kernel == FILTER_KERNEL_TDF2)
         {
-            inputBuffer[i] = fixedpoint_from_int(sample);
+            Tdf2State state = {section->x1, section->x2};
+            butterworthTdf2Section(section, &state, work, numSamples);
+            section->x1 = state.s1;
+            section->x2 = state.s2;
+            continue;
         }
+#ifdef ASMFILTER_X86_64
+        if (useAsm)
+        {
+            butterworthAsmSection(section, work, numSamples);
+            continue;
+        }
+#endif
+        butterworthDirectFormSection(section, work, numSamples);
+    }
+}
+
+// Function to apply Butterworth filter to a block of samples, samples are stride apart (1 for a single channel)
+// The offsets are xored with the samples to convert signed samples to and from the unsigned range used by the filter
+static void butterworthFilterStrided(ButterworthFilter *f, const uint16_t *input, uint16_t *output, size_t numSamples, size_t stride, uint16_t inputOffset, uint16_t outputOffset)
+{
+    // A design whose coefficients do not fit Q1.15 runs the Q17.15 kernel instead
+    if (f->kernel == FILTER_KERNEL_INT16 && butterworthInt16Strided(f, input, output, numSamples, stride, inputOffset, outputOffset) == 0)
+    {
+        return;
+    }
+    if (butterworthFilterSpecialized(f))
+    {
+        butterworthFilterSpecializedStrided(f, input, output, numSamples, stride, inputOffset, outputOffset);
+        return;
     }
 
-    // Initialize the filter
-    ButterworthFilter ButterworthFilter;
-    butterworthFilterInit(&ButterworthFilter);
+    // The first section sees whole samples, so its numerator folds when the design allows it, (NOTE: 9)
+    int folded = butterworthFilterDirectForm(f) && butterworthSectionFoldable(&f->sections[0]);
+    if (f->numSections == 1 && butterworthFilterDirectForm(f))
+    {
+        // A single biquad needs no work buffer
+        butterworthBiquadStrided(&f->sections[0], folded, input, output, numSamples, stride, inputOffset, outputOffset);
+        return;
+    }
 
-    // Apply Butterworth filter
-    for (size_t i = 0; i < numSamples; i++)
+    fixedpoint_t work[FILTER_CHUNK];
+    for (size_t start = 0; start < numSamples; start += FILTER_CHUNK)
     {
-        outputBuffer[i] = butterworthFilterApply(&ButterworthFilter, inputBuffer[i]);
-#ifdef DEBUG
-        printf("Input:\t%s\n", fixedpoint_str(inputBuffer[i]));
-        printf("Output:\t%s\n", fixedpoint_str(outputBuffer[i]));
-#endif
+        size_t n = numSamples - start < FILTER_CHUNK ? numSamples - start : FILTER_CHUNK;
+        const uint16_t *in = input + start * stride;
+        uint16_t *out = output + start * stride;
+        for (size_t i = 0; i < n; i++)
+        {
+            work[i] = fixedpoint_from_int((uint16_t)(in[i * stride] ^ inputOffset));
+        }
+        if (folded)
+        {
+            butterworthFoldedSection(&f->sections[0], work, n);
+        }
+        butterworthFilterSections(f, work, n, folded);
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i * stride] = fixedpoint_to_uint16(work[i]) ^ outputOffset;
+        }
     }
+}
 
-    // Write output samples to file
-    for (size_t i = 0; i < numSamples; ++i)
+// Function to apply Butterworth filter to a block of samples
+// The offsets are xored with the samples to convert signed samples to and from the unsigned range used by the filter
+void butterworthFilterBlock(ButterworthFilter *f, const uint16_t *input, uint16_t *output, size_t numSamples, uint16_t inputOffset, uint16_t outputOffset)
+{
+    if (f->numSections != 1 || !butterworthFilterDirectForm(f) || !butterworthSectionFoldable(&f->sections[0]) || butterworthFilterSpecialized(f))
     {
-        fprintf(outputFile, "%hu\n", fixedpoint_to_uint16(outputBuffer[i]));
+        butterworthFilterStrided(f, input, output, numSamples, 1, inputOffset, outputOffset);
+        return;
     }
 
-    printf("Finished Applying Butterworth Filter\n");
+    // The common single biquad, kept free of the stride arithmetic
+    butterworthBiquadStrided(&f->sections[0], 1, input, output, numSamples, 1, inputOffset, outputOffset);
+}
+
+#ifdef SIMDFILTER_AVX2
+// Copy the coefficients and state of a group of channels into lane order, (NOTE: 3)
+static void butterworthGatherLanes(const ButterworthFilter *filters, unsigned numLanes, SimdSections *lanes)
+{
+    lanes->numSections = filters[0].numSections;
+    for (unsigned s = 0; s < lanes->numSections; s++)
+    {
+        for (unsigned lane = 0; lane < numLanes; lane++)
+        {
+            const FilterSection *section = &filters[lane].sections[s];
+            lanes->coefficients[s][0][lane] = section->b0;
+            lanes->coefficients[s][1][lane] = section->b1;
+            lanes->coefficients[s][2][lane] = section->b2;
+            lanes->coefficients[s][3][lane] = section->a1;
+            lanes->coefficients[s][4][lane] = section->a2;
+            lanes->state[s][0][lane] = section->x1;
+            lanes->state[s][1][lane] = section->x2;
+            lanes->state[s][2][lane] = section->y1;
+            lanes->state[s][3][lane] = section->y2;
+        }
+    }
+}
 
-    // Cleanup
-    fclose(inputFile);
-    fclose(outputFile);
-    free(inputBuffer);
-    free(outputBuffer);
+// Copy the state of a group of channels back from lane order
+static void butterworthScatterLanes(ButterworthFilter *filters, unsigned numLanes, const SimdSections *lanes)
+{
+    for (unsigned s = 0; s < lanes->numSections; s++)
+    {
+        for (unsigned lane = 0; lane < numLanes; lane++)
+        {
+            FilterSection *section = &filters[lane].sections[s];
+            section->x1 = lanes->state[s][0][lane];
+            section->x2 = lanes->state[s][1][lane];
+            section->y1 = lanes->state[s][2][lane];
+            section->y2 = lanes->state[s][3][lane];
+        }
+    }
+}
 
-    return 0;
-}
\ No newline at end of file
+// Filter as many whole groups of channels as possible with the SIMD kernel. Returns the number of channels filtered.
+static unsigned butterworthFilterLanes(ButterworthFilter *filters, unsigned numChannels, const uint16_t *input, uint16_t *output, size_t numFrames)
+{
+    SimdSections lanes;
+    unsigned features = cpuFeatures(); // (NOTE: 10)
+    unsigned channel = 0;
+    while (numChannels - channel >= 8 && (features & CPU_FEATURE_AVX2))
+    {
+        unsigned numLanes = numChannels - channel >= 16 && (features & CPU_FEATURE_AVX512) ? 16 : 8;
+        // Every channel of a group must run the same number of sections
+        for (unsigned lane = 1; lane < numLanes; lane++)
+        {
+            if (filters[channel + lane].numSections != filters[channel].numSections)
+            {
+                return channel;
+            }
+        }
+
+        butterworthGatherLanes(&filters[channel], numLanes, &lanes);
+#ifdef SIMDFILTER_AVX512
+        if (numLanes == 16)
+        {
+            simdFilter16(&lanes, input + channel, output + channel, numFrames, numChannels, 0, 0);
+        }
+        else
+#endif
+        {
+            simdFilter8(&lanes, input + channel, output + channel, numFrames, numChannels, 0, 0);
+        }
+        butterworthScatterLanes(&filters[channel], numLanes, &lanes);
+        channel += numLanes;
+    }
+    return channel;
+}
+
+// Filter as many whole groups of SIMD_INT16_LANES channels as possible with the int16 kernel, (NOTE: 11). Returns the
+// number of channels filtered.
+static unsigned butterworthFilterLanesInt16(ButterworthFilter *filters, unsigned numChannels, const uint16_t *input, uint16_t *output, size_t numFrames)
+{
+    SimdSectionsInt16 lanes;
+    FilterInt16 q[SIMD_INT16_LANES];
+    unsigned channel = 0;
+    while (numChannels - channel >= SIMD_INT16_LANES && (cpuFeatures() & CPU_FEATURE_AVX2))
+    {
+        // Every channel of a group must run the same number of sections with the same whole part of a1
+        ButterworthFilter *group = &filters[channel];
+        lanes.numSections = group[0].numSections;
+        for (unsigned lane = 0; lane < SIMD_INT16_LANES; lane++)
+        {
+            if (butterworthInt16Init(&group[lane], &q[lane]) < 0 || group[lane].numSections != lanes.numSections)
+            {
+                return channel;
+            }
+            for (unsigned s = 0; s < lanes.numSections; s++)
+            {
+                if (q[lane].sections[s].wholeA1 != q[0].sections[s].wholeA1)
+                {
+                    return channel;
+                }
+            }
+        }
+
+        for (unsigned s = 0; s < lanes.numSections; s++)
+        {
+            lanes.wholeA1[s] = q[0].sections[s].wholeA1;
+            for (unsigned lane = 0; lane < SIMD_INT16_LANES; lane++)
+            {
+                const Int16Section *qs = &q[lane].sections[s];
+                const FilterSection *section = &group[lane].sections[s];
+                lanes.coefficients[s][0][lane] = qs->b0;
+                lanes.coefficients[s][1][lane] = qs->b1;
+                lanes.coefficients[s][2][lane] = qs->b2;
+                lanes.coefficients[s][3][lane] = qs->a1;
+                lanes.coefficients[s][4][lane] = qs->a2;
+                lanes.state[s][0][lane] = butterworthInt16FromState(section->x1, qs->inputLevel);
+                lanes.state[s][1][lane] = butterworthInt16FromState(section->x2, qs->inputLevel);
+                lanes.state[s][2][lane] = butterworthInt16FromState(section->y1, qs->outputLevel);
+                lanes.state[s][3][lane] = butterworthInt16FromState(section->y2, qs->outputLevel);
+            }
+        }
+        for (unsigned lane = 0; lane < SIMD_INT16_LANES; lane++)
+        {
+            lanes.outputBias[lane] = q[lane].outputBias;
+        }
+
+        simdFilterInt16(&lanes, input + channel, output + channel, numFrames, numChannels);
+
+        for (unsigned s = 0; s < lanes.numSections; s++)
+        {
+            for (unsigned lane = 0; lane < SIMD_INT16_LANES; lane++)
+            {
+                const Int16Section *qs = &q[lane].sections[s];
+                FilterSection *section = &group[lane].sections[s];
+                section->x1 = butterworthInt16ToState(lanes.state[s][0][lane], qs->inputLevel);
+                section->x2 = butterworthInt16ToState(lanes.state[s][1][lane], qs->inputLevel);
+                section->y1 = butterworthInt16ToState(lanes.state[s][2][lane], qs->outputLevel);
+                section->y2 = butterworthInt16ToState(lanes.state[s][3][lane], qs->outputLevel);
+            }
+        }
+        channel += SIMD_INT16_LANES;
+    }
+    return channel;
+}
+#endif
+
+// Function to apply a Butterworth filter per channel to a block of interleaved frames
+// Each channel has its own filter state, numSamples is a whole number of frames
+void butterworthFilterChannels(ButterworthFilter *filters, unsigned numChannels, const uint16_t *input, uint16_t *output, size_t numSamples)
+{
+    unsigned channel = 0;
+#ifdef SIMDFILTER_AVX2
+    if (filters[0].kernel == FILTER_KERNEL_AUTO)
+    {
+        channel = butterworthFilterLanes(filters, numChannels, input, output, numSamples / numChannels); // (NOTE: 3)
+    }
+    else if (filters[0].kernel == FILTER_KERNEL_INT16)
+    {
+        channel = butterworthFilterLanesInt16(filters, numChannels, input, output, numSamples / numChannels); // (NOTE: 11)
+    }
+#endif
+    for (; channel < numChannels; channel++)
+    {
+        butterworthFilterStrided(&filters[channel], input + channel, output + channel, numSamples / numChannels, numChannels, 0, 0);
+    }
+}
+
+// One sample of zero input response of the cascade, in state coordinates: the state after a sample of zero input is
+// transition times the state before it, (NOTE: 7). Returns the number of state words.
+static unsigned butterworthFilterTransition(const ButterworthFilter *f, double transition[][PARALLEL_STATE_MAX])
+{
+    unsigned size = 4 * f->numSections;
+    double input[PARALLEL_STATE_MAX] = {0.0}; // The input of the section, as a combination of the state
+    memset(transition, 0, PARALLEL_STATE_MAX * sizeof(transition[0]));
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        const FilterSection *section = &f->sections[s];
+        double b0 = (double)section->b0 / FIXEDPOINT_ONE, b1 = (double)section->b1 / FIXEDPOINT_ONE, b2 = (double)section->b2 / FIXEDPOINT_ONE;
+        double a1 = (double)section->a1 / FIXEDPOINT_ONE, a2 = (double)section->a2 / FIXEDPOINT_ONE;
+        unsigned x1 = 4 * s, x2 = x1 + 1, y1 = x1 + 2, y2 = x1 + 3;
+        double output[PARALLEL_STATE_MAX];
+        for (unsigned k = 0; k < size; k++)
+        {
+            if (f->kernel == FILTER_KERNEL_TDF2)
+            {
+                // y = b0 u + s1, s1 = b1 u - a1 y + s2, s2 = b2 u - a2 y with s1, s2 in x1, x2, (NOTE: 6)
+                output[k] = b0 * input[k] + (k == x1);
+                transition[x1][k] = b1 * input[k] - a1 * output[k] + (k == x2);
+                transition[x2][k] = b2 * input[k] - a2 * output[k];
+            }
+            else
+            {
+                output[k] = b0 * input[k] + b1 * (k == x1) + b2 * (k == x2) - a1 * (k == y1) - a2 * (k == y2);
+                transition[x1][k] = input[k];
+                transition[x2][k] = k == x1;
+                transition[y1][k] = output[k];
+                transition[y2][k] = k == y1;
+            }
+        }
+        memcpy(input, output, sizeof(output));
+    }
+    return size;
+}
+
+// product = a b for square matrices of size rows, product may not be a or b
+static void transitionMultiply(double a[][PARALLEL_STATE_MAX], double b[][PARALLEL_STATE_MAX], double product[][PARALLEL_STATE_MAX], unsigned size)
+{
+    for (unsigned i = 0; i < size; i++)
+    {
+        for (unsigned j = 0; j < size; j++)
+        {
+            double sum = 0.0;
+            for (unsigned k = 0; k < size; k++)
+            {
+                sum += a[i][k] * b[k][j];
+            }
+            product[i][j] = sum;
+        }
+    }
+}
+
+// Samples after which the zero input response from any 32 bit state is below half a raw LSB, at most limit
+static size_t transitionDecay(double transition[][PARALLEL_STATE_MAX], unsigned size, size_t limit)
+{
+    double power[PARALLEL_STATE_MAX][PARALLEL_STATE_MAX], scratch[PARALLEL_STATE_MAX][PARALLEL_STATE_MAX];
+    memcpy(power, transition, sizeof(power));
+    size_t length = 1;
+    while (length < limit)
+    {
+        double norm = 0.0; // Largest row sum, the most a state word can become for state words of 1
+        for (unsigned i = 0; i < size; i++)
+        {
+            double sum = 0.0;
+            for (unsigned j = 0; j < size; j++)
+            {
+                sum += fabs(power[i][j]);
+            }
+            norm = sum > norm ? sum : norm;
+        }
+        if (norm * ldexp(1.0, 31) < 0.5)
+        {
+            break;
+        }
+        transitionMultiply(power, power, scratch, size);
+        memcpy(power, scratch, sizeof(scratch));
+        length *= 2;
+    }
+    return length < limit ? length : limit;
+}
+
+// Set the state of every section to its steady state for a constant input, so a pass starts without a transient
+static void butterworthFilterSteadyState(ButterworthFilter *f, fixedpoint_t input)
+{
+    double x = input;
+    for (unsigned s = 0; s < f->numSections; s++)
+    {
+        FilterSection *section = &f->sections[s];
+        double y = x * ((double)section->b0 + section->b1 + section->b2) / ((double)FIXEDPOINT_ONE + section->a1 + section->a2);
+        if (f->kernel == FILTER_KERNEL_TDF2)
+        {
+            // s2 = b2 x - a2 y and s1 = b1 x - a1 y + s2, (NOTE: 6)
+            double s2 = ((double)section->b2 * x - (double)section->a2 * y) / FIXEDPOINT_ONE;
+            double s1 = ((double)section->b1 * x - (double)section->a1 * y) / FIXEDPOINT_ONE + s2;
+            section->x1 = (fixedpoint_t)floor(s1 + 0.5);
+            section->x2 = (fixedpoint_t)floor(s2 + 0.5);
+            section->y1 = section->y2 = FIXEDPOINT_ZERO;
+        }
+        else
+        {
+            section->x1 = section->x2 = (fixedpoint_t)floor(x + 0.5);
+            section->y1 = section->y2 = (fixedpoint_t)floor(y + 0.5);
+        }
+        x = y;
+    }
+}
+
+// Whether two copies of a design have the same state in every section
+static int butterworthFilterSameState(const ButterworthFilter *a, const ButterworthFilter *b)
+{
+    for (unsigned s = 0; s < a->numSections; s++)
+    {
+        const FilterSection *x = &a->sections[s], *y = &b->sections[s];
+        if (x->x1 != y->x1 || x->x2 != y->x2 || x->y1 != y->y1 || x->y2 != y->y2)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// One chunk of a channel filtered on its own thread, (NOTE: 7)
+typedef struct ParallelChunk
+{
+    ButterworthFilter filter; // State at the start of the chunk, then at its end
+    const uint16_t *input;
+    uint16_t *output;
+    size_t numSamples;
+    size_t warmup; // Samples before the chunk filtered first and discarded
+    uint16_t inputOffset;
+    uint16_t outputOffset;
+    size_t firstCheckpoint;  // Samples into the chunk of the first checkpoint, each further one is twice as far
+    unsigned numCheckpoints;
+    FilterSection checkpoints[PARALLEL_CHECKPOINTS][MAX_SECTIONS]; // Sections at every checkpoint
+    pthread_t thread;
+} ParallelChunk;
+
+// Samples into a chunk of checkpoint k
+static size_t parallelCheckpoint(const ParallelChunk *chunk, unsigned k)
+{
+    return chunk->firstCheckpoint << k;
+}
+
+static void *parallelChunkFilter(void *argument)
+{
+    ParallelChunk *chunk = (ParallelChunk *)argument;
+    uint16_t discard[FILTER_CHUNK];
+    for (size_t done = 0; done < chunk->warmup; done += FILTER_CHUNK)
+    {
+        size_t n = chunk->warmup - done < FILTER_CHUNK ? chunk->warmup - done : FILTER_CHUNK;
+        butterworthFilterBlock(&chunk->filter, chunk->input - chunk->warmup + done, discard, n, chunk->inputOffset, chunk->outputOffset);
+    }
+    size_t done = 0;
+    for (unsigned k = 0; k < chunk->numCheckpoints; k++)
+    {
+        size_t checkpoint = parallelCheckpoint(chunk, k);
+        butterworthFilterBlock(&chunk->filter, chunk->input + done, chunk->output + done, checkpoint - done, chunk->inputOffset,
+                               chunk->outputOffset);
+        memcpy(chunk->checkpoints[k], chunk->filter.sections, chunk->filter.numSections * sizeof(FilterSection));
+        done = checkpoint;
+    }
+    butterworthFilterBlock(&chunk->filter, chunk->input + done, chunk->output + done, chunk->numSamples - done, chunk->inputOffset,
+                           chunk->outputOffset);
+    return NULL;
+}
+
+// Filter every chunk, the first on the calling thread. A chunk whose thread can not be started runs on the caller too.
+static void parallelChunksFilter(ParallelChunk *chunks, unsigned numChunks)
+{
+    int started[PARALLEL_MAX_THREADS] = {0};
+    for (unsigned c = 1; c < numChunks; c++)
+    {
+        started[c] = pthread_create(&chunks[c].thread, NULL, parallelChunkFilter, &chunks[c]) == 0;
+    }
+    parallelChunkFilter(&chunks[0]);
+    for (unsigned c = 1; c < numChunks; c++)
+    {
+        if (started[c])
+        {
+            pthread_join(chunks[c].thread, NULL);
+        }
+        else
+        {
+            parallelChunkFilter(&chunks[c]);
+        }
+    }
+}
+
+// Filter a chunk again from the true state at its start, held by filter, which receives the true state at its end.
+// Stops at the first checkpoint where the state meets that of the chunk's own run, which the rest of the output and the
+// state at the end then are already, (NOTE: 7).
+static void parallelChunkFixUp(const ParallelChunk *chunk, ButterworthFilter *filter)
+{
+    size_t done = 0;
+    for (unsigned k = 0; k < chunk->numCheckpoints; k++)
+    {
+        size_t checkpoint = parallelCheckpoint(chunk, k);
+        butterworthFilterBlock(filter, chunk->input + done, chunk->output + done, checkpoint - done, chunk->inputOffset, chunk->outputOffset);
+        done = checkpoint;
+        ButterworthFilter own = *filter;
+        memcpy(own.sections, chunk->checkpoints[k], own.numSections * sizeof(FilterSection));
+        if (butterworthFilterSameState(filter, &own))
+        {
+            *filter = chunk->filter;
+            return;
+        }
+    }
+    butterworthFilterBlock(filter, chunk->input + done, chunk->output + done, chunk->numSamples - done, chunk->inputOffset, chunk->outputOffset);
+}
+
+// Function to apply a Butterworth filter to one long channel on up to numThreads threads, (NOTE: 7)
+// With an overlap of 0 the chunk boundaries are fixed up from the true states, otherwise every chunk warms up on that
+// many samples before it. The filter holds the state at the start and receives the state at the end.
+void butterworthFilterParallel(ButterworthFilter *f, const uint16_t *input, uint16_t *output, size_t numSamples, uint16_t inputOffset,
+                               uint16_t outputOffset, unsigned numThreads, size_t overlap)
+{
+    unsigned numChunks = numThreads < PARALLEL_MAX_THREADS ? numThreads : PARALLEL_MAX_THREADS;
+    if (numSamples / PARALLEL_MIN_CHUNK < numChunks)
+    {
+        numChunks = (unsigned)(numSamples / PARALLEL_MIN_CHUNK);
+    }
+    void *memory = NULL;
+    if (numChunks < 2 || posix_memalign(&memory, FILTER_CACHE_LINE, numChunks * sizeof(ParallelChunk)) != 0)
+    {
+        butterworthFilterBlock(f, input, output, numSamples, inputOffset, outputOffset);
+        return;
+    }
+    ParallelChunk *chunks = memory;
+
+    // Every chunk but the first starts from the steady state for its first sample, so it starts without a transient
+    double transition[PARALLEL_STATE_MAX][PARALLEL_STATE_MAX];
+    size_t chunkSize = (numSamples + numChunks - 1) / numChunks;
+    size_t decay = overlap > 0 ? chunkSize : transitionDecay(transition, butterworthFilterTransition(f, transition), chunkSize);
+    for (unsigned c = 0; c < numChunks; c++)
+    {
+        ParallelChunk *chunk = &chunks[c];
+        size_t start = c * chunkSize;
+        chunk->input = input + start;
+        chunk->output = output + start;
+        chunk->numSamples = c == numChunks - 1 ? numSamples - start : chunkSize;
+        chunk->warmup = c == 0 ? 0 : (overlap < start ? overlap : start);
+        chunk->inputOffset = inputOffset;
+        chunk->outputOffset = outputOffset;
+        chunk->filter = *f;
+        if (c > 0)
+        {
+            butterworthFilterSteadyState(&chunk->filter, fixedpoint_from_int((uint16_t)(chunk->input[-(ptrdiff_t)chunk->warmup] ^ inputOffset)));
+        }
+        chunk->firstCheckpoint = decay;
+        chunk->numCheckpoints = 0;
+        while (c > 0 && overlap == 0 && chunk->numCheckpoints < PARALLEL_CHECKPOINTS &&
+               parallelCheckpoint(chunk, chunk->numCheckpoints) < chunk->numSamples)
+        {
+            chunk->numCheckpoints++;
+        }
+    }
+    parallelChunksFilter(chunks, numChunks);
+
+    // Hand the true state on from chunk to chunk, fixing up the start of each
+    ButterworthFilter state = chunks[0].filter;
+    for (unsigned c = 1; c < numChunks; c++)
+    {
+        if (overlap > 0)
+        {
+            state = chunks[c].filter;
+        }
+        else
+        {
+            parallelChunkFixUp(&chunks[c], &state);
+        }
+    }
+    *f = state;
+    free(chunks);
+}
+
+// Filter fixed point samples in place a chunk at a time, backwards in time when reverse is set
+static void butterworthFilterWork(ButterworthFilter *f, fixedpoint_t *work, size_t numSamples, int reverse)
+{
+    for (size_t i = 0; reverse && i < numSamples / 2; i++)
+    {
+        fixedpoint_t sample = work[i];
+        work[i] = work[numSamples - 1 - i];
+        work[numSamples - 1 - i] = sample;
+    }
+    for (size_t start = 0; start < numSamples; start += FILTER_CHUNK)
+    {
+        butterworthFilterSections(f, work + start, numSamples - start < FILTER_CHUNK ? numSamples - start : FILTER_CHUNK, 0);
+    }
+    for (size_t i = 0; reverse && i < numSamples / 2; i++)
+    {
+        fixedpoint_t sample = work[i];
+        work[i] = work[numSamples - 1 - i];
+        work[numSamples - 1 - i] = sample;
+    }
+}
+
+// The backward pass of one chunk of a zero phase filter, (NOTE: 8)
+typedef struct ZeroPhaseChunk
+{
+    ButterworthFilter filter; // State at the end of the chunk, then at its start
+    fixedpoint_t *work;
+    size_t numSamples;
+    fixedpoint_t *forward;    // Forward output of the chunk, filtered backward again from the true state
+    size_t firstCheckpoint;   // Samples before the end of the chunk of the first checkpoint, each further one is twice as far
+    unsigned numCheckpoints;
+    FilterSection checkpoints[PARALLEL_CHECKPOINTS][MAX_SECTIONS]; // Sections at every checkpoint
+    pthread_t thread;
+    int started;
+} ZeroPhaseChunk;
+
+static void *zeroPhaseChunkFilter(void *argument)
+{
+    ZeroPhaseChunk *chunk = (ZeroPhaseChunk *)argument;
+    size_t done = 0;
+    for (unsigned k = 0; k < chunk->numCheckpoints; k++)
+    {
+        size_t checkpoint = chunk->firstCheckpoint << k;
+        butterworthFilterWork(&chunk->filter, chunk->work + chunk->numSamples - checkpoint, checkpoint - done, 1);
+        memcpy(chunk->checkpoints[k], chunk->filter.sections, chunk->filter.numSections * sizeof(FilterSection));
+        done = checkpoint;
+    }
+    butterworthFilterWork(&chunk->filter, chunk->work, chunk->numSamples - done, 1);
+    return NULL;
+}
+
+// Filter a chunk backward again from the true state at its end, held by filter, which receives the true state at its
+// start. Stops at the first checkpoint where the state meets that of the chunk's own run, as in parallelChunkFixUp.
+static void zeroPhaseChunkFixUp(const ZeroPhaseChunk *chunk, ButterworthFilter *filter)
+{
+    size_t done = 0;
+    for (unsigned k = 0; k < chunk->numCheckpoints; k++)
+    {
+        size_t checkpoint = chunk->firstCheckpoint << k, start = chunk->numSamples - checkpoint;
+        memcpy(chunk->work + start, chunk->forward + start, (checkpoint - done) * sizeof(fixedpoint_t));
+        butterworthFilterWork(filter, chunk->work + start, checkpoint - done, 1);
+        done = checkpoint;
+        ButterworthFilter own = *filter;
+        memcpy(own.sections, chunk->checkpoints[k], own.numSections * sizeof(FilterSection));
+        if (butterworthFilterSameState(filter, &own))
+        {
+            *filter = chunk->filter;
+            return;
+        }
+    }
+    memcpy(chunk->work, chunk->forward, (chunk->numSamples - done) * sizeof(fixedpoint_t));
+    butterworthFilterWork(filter, chunk->work, chunk->numSamples - done, 1);
+}
+
+// Function to filter one channel of fixed point samples forward and backward in place on up to numThreads threads.
+// The samples include the padding, see butterworthFilterZeroPhasePad. Returns 0 on success, -1 if out of memory.
+int butterworthFilterZeroPhase(const ButterworthFilter *design, fixedpoint_t *work, size_t numSamples, unsigned numThreads)
+{
+    ButterworthFilter forward = *design;
+    ButterworthFilter backward = *design;
+    if (numSamples == 0)
+    {
+        return 0;
+    }
+    butterworthFilterSteadyState(&forward, work[0]);
+
+    unsigned numChunks = numThreads < PARALLEL_MAX_THREADS ? numThreads : PARALLEL_MAX_THREADS;
+    if (numSamples / PARALLEL_MIN_CHUNK < numChunks)
+    {
+        numChunks = (unsigned)(numSamples / PARALLEL_MIN_CHUNK);
+    }
+    if (numChunks < 2)
+    {
+        butterworthFilterWork(&forward, work, numSamples, 0);
+        butterworthFilterSteadyState(&backward, work[numSamples - 1]);
+        butterworthFilterWork(&backward, work, numSamples, 1);
+        return 0;
+    }
+
+    // Chunk ends and checkpoints lie where a backward pass over the whole channel starts a FILTER_CHUNK, so kernels that
+    // round by block see the same pieces as on one thread. The first chunk takes the remainder.
+    double transition[PARALLEL_STATE_MAX][PARALLEL_STATE_MAX];
+    size_t chunkSize = ((numSamples + numChunks - 1) / numChunks + FILTER_CHUNK - 1) / FILTER_CHUNK * FILTER_CHUNK;
+    size_t decay = transitionDecay(transition, butterworthFilterTransition(design, transition), chunkSize);
+    decay = (decay + FILTER_CHUNK - 1) / FILTER_CHUNK * FILTER_CHUNK;
+    void *memory = NULL;
+    fixedpoint_t *forwardOutput = (fixedpoint_t *)malloc((numChunks - 1) * chunkSize * sizeof(fixedpoint_t));
+    if (forwardOutput == NULL || posix_memalign(&memory, FILTER_CACHE_LINE, numChunks * sizeof(ZeroPhaseChunk)) != 0)
+    {
+        free(forwardOutput);
+        return -1;
+    }
+    ZeroPhaseChunk *chunks = memory;
+    for (unsigned c = 0; c < numChunks; c++)
+    {
+        ZeroPhaseChunk *chunk = &chunks[c];
+        size_t end = numSamples - (numChunks - 1 - c) * chunkSize;
+        chunk->work = work + (c == 0 ? 0 : end - chunkSize);
+        chunk->numSamples = c == 0 ? end : chunkSize;
+        chunk->forward = c < numChunks - 1 ? forwardOutput + c * chunkSize : NULL;
+        chunk->firstCheckpoint = decay;
+        chunk->numCheckpoints = 0;
+        while (c < numChunks - 1 && chunk->numCheckpoints < PARALLEL_CHECKPOINTS && decay << chunk->numCheckpoints < chunk->numSamples)
+        {
+            chunk->numCheckpoints++;
+        }
+        chunk->started = 0;
+    }
+
+    // The forward pass runs in the same pieces as on one thread. As soon as it is past the end of a chunk, the backward
+    // pass of the chunk starts on a thread of its own from the steady state for the chunk's last forward output. Only the
+    // last one starts from its true state.
+    unsigned next = 0;
+    for (size_t start = 0; start < numSamples; start += FILTER_CHUNK)
+    {
+        butterworthFilterWork(&forward, work + start, numSamples - start < FILTER_CHUNK ? numSamples - start : FILTER_CHUNK, 0);
+        for (; next < numChunks && (size_t)(chunks[next].work - work) + chunks[next].numSamples <= start + FILTER_CHUNK; next++)
+        {
+            ZeroPhaseChunk *chunk = &chunks[next];
+            chunk->filter = *design;
+            butterworthFilterSteadyState(&chunk->filter, chunk->work[chunk->numSamples - 1]);
+            if (next == numChunks - 1)
+            {
+                zeroPhaseChunkFilter(chunk);
+            }
+            else
+            {
+                memcpy(chunk->forward, chunk->work, chunk->numSamples * sizeof(fixedpoint_t));
+                chunk->started = pthread_create(&chunk->thread, NULL, zeroPhaseChunkFilter, chunk) == 0;
+            }
+        }
+    }
+    for (unsigned c = 0; c + 1 < numChunks; c++)
+    {
+        if (chunks[c].started)
+        {
+            pthread_join(chunks[c].thread, NULL);
+        }
+        else
+        {
+            zeroPhaseChunkFilter(&chunks[c]);
+        }
+    }
+
+    // Hand the true state on from the last chunk to the first, fixing up the end of each (NOTE: 7)
+    ButterworthFilter state = chunks[numChunks - 1].filter;
+    for (unsigned c = numChunks - 1; c-- > 0;)
+    {
+        zeroPhaseChunkFixUp(&chunks[c], &state);
+    }
+    free(chunks);
+    free(forwardOutput);
+    return 0;
+}
+
+// Function to convert one channel of interleaved frames to fixed point with the odd extension of a zero phase filter at
+// both ends, (NOTE: 8). work has room for numFrames + 2 * padding samples.
+void butterworthFilterZeroPhasePad(const uint16_t *input, size_t numFrames, size_t stride, uint16_t inputOffset, size_t padding, fixedpoint_t *work)
+{
+    for (size_t i = 0; i < numFrames; i++)
+    {
+        work[padding + i] = fixedpoint_from_int((uint16_t)(input[i * stride] ^ inputOffset));
+    }
+    for (size_t k = 1; k <= padding; k++)
+    {
+        // Reflect about the end samples, a signal shorter than the padding keeps reflecting its ends
+        size_t before = k < numFrames ? k : numFrames - 1;
+        size_t after = k < numFrames ? numFrames - 1 - k : 0;
+        long first = 2L * (uint16_t)(input[0] ^ inputOffset) - (uint16_t)(input[before * stride] ^ inputOffset);
+        long last = 2L * (uint16_t)(input[(numFrames - 1) * stride] ^ inputOffset) - (uint16_t)(input[after * stride] ^ inputOffset);
+        first = first < 0 ? 0 : first > 65535 ? 65535 : first;
+        last = last < 0 ? 0 : last > 65535 ? 65535 : last;
+        work[padding - k] = fixedpoint_from_int((int32_t)first);
+        work[padding + numFrames - 1 + k] = fixedpoint_from_int((int32_t)last);
+    }
+}
+
+// Handle of libbutterworth.h, (NOTE: 12)
+struct Butterworth
+{
+    ButterworthFilter filter;
+};
+
+Butterworth *butterworthCreate(double samplingRate, double cutoffFrequency, unsigned order)
+{
+    if (!butterworthFilterDesignable(samplingRate, cutoffFrequency, order))
+    {
+        return NULL;
+    }
+    void *memory;
+    if (posix_memalign(&memory, FILTER_CACHE_LINE, sizeof(Butterworth)) != 0)
+    {
+        return NULL;
+    }
+    Butterworth *handle = memory;
+    butterworthFilterInit(&handle->filter, samplingRate, cutoffFrequency, order);
+    handle->filter.kernel = FILTER_KERNEL_AUTO;
+    return handle;
+}
+
+void butterworthProcessBlock(Butterworth *handle, const uint16_t *input, uint16_t *output, size_t numSamples)
+{
+    butterworthFilterBlock(&handle->filter, input, output, numSamples, 0, 0);
+}
+
+void butterworthProcessFixed(Butterworth *handle, int32_t *samples, size_t numSamples)
+{
+    butterworthFilterSections(&handle->filter, samples, numSamples, 0);
+}
+
+void butterworthReset(Butterworth *handle)
+{
+    for (unsigned i = 0; i < handle->filter.numSections; i++)
+    {
+        FilterSection *section = &handle->filter.sections[i];
+        section->x1 = FIXEDPOINT_ZERO;
+        section->x2 = FIXEDPOINT_ZERO;
+        section->y1 = FIXEDPOINT_ZERO;
+        section->y2 = FIXEDPOINT_ZERO;
+    }
+}
+
+void butterworthDestroy(Butterworth *handle)
+{
+    free(handle);
+}
+
+struct ButterworthBank
+{
+    ButterworthFilter design; // Coefficients shared by every filter, the state of its sections is not used
+    size_t numFilters;
+    Tdf2State *state; // numSections states of every filter, one filter after the other, (NOTE: 6)
+};
+
+ButterworthBank *butterworthBankCreate(double samplingRate, double cutoffFrequency, unsigned order, size_t numFilters)
+{
+    if (numFilters == 0 || numFilters > SIZE_MAX / (MAX_SECTIONS * sizeof(Tdf2State)) ||
+        !butterworthFilterDesignable(samplingRate, cutoffFrequency, order))
+    {
+        return NULL;
+    }
+    void *memory;
+    if (posix_memalign(&memory, FILTER_CACHE_LINE, sizeof(ButterworthBank)) != 0)
+    {
+        return NULL;
+    }
+    ButterworthBank *bank = memory;
+    butterworthFilterInit(&bank->design, samplingRate, cutoffFrequency, order);
+    bank->design.kernel = FILTER_KERNEL_TDF2;
+    bank->numFilters = numFilters;
+    bank->state = calloc(numFilters * bank->design.numSections, sizeof(Tdf2State));
+    if (bank->state == NULL)
+    {
+        free(bank);
+        return NULL;
+    }
+    return bank;
+}
+
+void butterworthBankProcessBlock(ButterworthBank *bank, size_t filter, const uint16_t *input, uint16_t *output, size_t numSamples)
+{
+    const ButterworthFilter *f = &bank->design;
+    Tdf2State *state = &bank->state[filter * f->numSections];
+    fixedpoint_t work[FILTER_CHUNK];
+    for (size_t start = 0; start < numSamples; start += FILTER_CHUNK)
+    {
+        size_t n = numSamples - start < FILTER_CHUNK ? numSamples - start : FILTER_CHUNK;
+        for (size_t i = 0; i < n; i++)
+        {
+            work[i] = fixedpoint_from_int(input[start + i]);
+        }
+        for (unsigned s = 0; s < f->numSections; s++)
+        {
+            butterworthTdf2Section(&f->sections[s], &state[s], work, n);
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            output[start + i] = fixedpoint_to_uint16(work[i]);
+        }
+    }
+}
+
+void butterworthBankReset(ButterworthBank *bank)
+{
+    memset(bank->state, 0, bank->numFilters * bank->design.numSections * sizeof(Tdf2State));
+}
+
+void butterworthBankDestroy(ButterworthBank *bank)
+{
+    if (bank != NULL)
+    {
+        free(bank->state);
+        free(bank);
+    }
+}
+
+#ifndef BUTTERWORTH_LIBRARY // The command line tool, left out of make lib
+
+// Default working set for the streaming pipeline, in bytes
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+// Blocks queued between each pair of stages in the threaded pipeline, must be a power of two
+#define PIPELINE_DEPTH 4
+// Reads and writes kept in flight by the io_uring backend
+#define DEFAULT_QUEUE_DEPTH 8
+
+// Settings taken from the command line
+typedef struct FilterOptions
+{
+    size_t blockSize;
+    SampleFormat inputFormat;
+    SampleFormat outputFormat;
+    int outputHeader;
+    int useMmap;
+    int usePipeline;
+    int useUring;
+    unsigned queueDepth;
+    unsigned outputBits; // Sample width of WAV output, 0 to keep the width of the input
+    double samplingRate;    // Hertz
+    double cutoffFrequency; // Hertz
+    unsigned order;
+    const char *coefficientCache; // Cache file shared between runs, NULL for none
+    ButterworthFilter design;     // Designed filter with cleared state, copied to start every channel
+    FilterKernel kernel;
+    FilterLookahead lookahead; // Matrices of the look-ahead kernel, shared by every copy of the design
+    int verify;                // Run the scalar kernel alongside and compare, see FilterCheck
+    unsigned threads;          // Threads sharing one mapped channel, (NOTE: 7)
+    size_t overlap;            // Warm-up samples of each parallel chunk, 0 to fix up the chunk boundaries
+    int zeroPhase;             // Filter forward and backward in memory, (NOTE: 8)
+    int emitKernel;            // Print specialized.h for the design instead of filtering, (NOTE: 9)
+    PhaseStats *stats;         // Time of each phase of the run, NULL without --stats
+    const char *statsPath;     // File the --stats JSON is written to, - for standard output
+    int batch;           // The paths are a file list or directory and an output directory
+    unsigned jobs;       // Batch worker threads, 0 for one per online CPU
+    const char *inputPath;
+    const char *outputPath;
+} FilterOptions;
+
+// Open the output with the channels and sample rate of the input, so a WAV file keeps its layout.
+// A NULL buffer lets the writer allocate its own.
+static int openOutput(SampleWriter *writer, const FilterOptions *options, const char *path, const SampleReader *reader, char *buffer)
+{
+    SampleLayout layout = reader->layout;
+    if (layout.sampleRate == 0)
+    {
+        layout.sampleRate = (unsigned)(options->samplingRate + 0.5);
+    }
+    else if (layout.sampleRate != options->samplingRate)
+    {
+        fprintf(stderr, "Warning: the filter is designed for %g Hz, the input is sampled at %u Hz\n", options->samplingRate, layout.sampleRate);
+    }
+    if (options->outputBits != 0)
+    {
+        layout.bitsPerSample = options->outputBits;
+    }
+    if (buffer != NULL)
+    {
+        return sampleWriterOpenBuffer(writer, path, buffer, options->blockSize, options->outputFormat, options->outputHeader, &layout);
+    }
+    return sampleWriterOpen(writer, path, options->blockSize, options->outputFormat, options->outputHeader, &layout);
+}
+
+// Samples per block for a working set split evenly between input and output, rounded to whole frames
+static size_t frameBlockSamples(size_t blockSize, unsigned numChannels)
+{
+    size_t blockSamples = blockSize / (2 * sizeof(uint16_t));
+    blockSamples -= blockSamples % numChannels;
+    return blockSamples < numChannels ? numChannels : blockSamples;
+}
+
+#define FILTER_READ_ERROR -1
+#define FILTER_WRITE_ERROR -2
+
+// The scalar reference run alongside the selected kernel by --verify, and how far the two outputs are apart
+typedef struct FilterCheck
+{
+    ButterworthFilter filters[SAMPLE_MAX_CHANNELS];
+    uint16_t *output;
+    size_t numSamples;
+    size_t numDiffering;
+    unsigned maxDeviation; // Output LSBs
+} FilterCheck;
+
+// Compare the output of the selected kernel with the reference output of the same samples
+static void filterCheckCompare(FilterCheck *check, const uint16_t *output, size_t numSamples)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        // Both outputs wrap around the same way, so the distance is taken modulo 2^16
+        uint16_t difference = (uint16_t)(output[i] - check->output[i]);
+        unsigned deviation = difference > 32768 ? 65536u - difference : difference;
+        check->numDiffering += deviation != 0;
+        check->maxDeviation = deviation > check->maxDeviation ? deviation : check->maxDeviation;
+    }
+    check->numSamples += numSamples;
+}
+
+// Filter a block with the reference filters and compare it with the output of the selected kernel
+static void filterCheckBlock(FilterCheck *check, unsigned numChannels, const uint16_t *input, const uint16_t *output, size_t numSamples)
+{
+    butterworthFilterChannels(check->filters, numChannels, input, check->output, numSamples);
+    filterCheckCompare(check, output, numSamples);
+}
+
+// Add the time since *lap to a phase for --stats and start the next lap there, nothing without --stats
+static void statsLap(PhaseStats *stats, StatsPhase phase, uint64_t *lap, uint64_t bytes)
+{
+    if (stats != NULL)
+    {
+        uint64_t now = statsNow();
+        statsAdd(stats, phase, now - *lap, bytes);
+        *lap = now;
+    }
+}
+
+// Split the time since *lap between the system calls of a reader or writer (ioPhase) and the work around them, the
+// system calls took the ioNanoseconds since ioStart and moved bytes
+static void statsLapIo(PhaseStats *stats, StatsPhase phase, StatsPhase ioPhase, uint64_t *lap, uint64_t ioNanoseconds,
+                       uint64_t ioStart, uint64_t bytes)
+{
+    if (stats != NULL)
+    {
+        uint64_t now = statsNow();
+        uint64_t io = ioNanoseconds - ioStart;
+        statsAdd(stats, ioPhase, io, bytes);
+        statsAdd(stats, phase, now - *lap - io, 0);
+        *lap = now;
+    }
+}
+
+// Filter the rest of the input into the output one block at a time, the filters carry their state between blocks.
+// Returns 0 on success, FILTER_READ_ERROR or FILTER_WRITE_ERROR. *numSamples counts the samples filtered.
+static int filterSamples(SampleReader *reader, SampleWriter *writer, ButterworthFilter *filters, uint16_t *inputBuffer,
+                         uint16_t *outputBuffer, size_t blockSamples, int flushBlocks, FilterCheck *check, PhaseStats *stats,
+                         size_t *numSamples)
+{
+    unsigned numChannels = reader->layout.channels;
+    long count;
+    *numSamples = 0;
+    // The phases are timed a block at a time, and only with --stats
+    uint64_t lap = stats != NULL ? statsNow() : 0;
+    uint64_t readStart = reader->readNanoseconds, bytesRead = reader->bytesRead;
+    // Read the next block of input samples from file, until the end of the file
+    while ((count = sampleReaderRead(reader, inputBuffer, blockSamples)) > 0)
+    {
+        statsLapIo(stats, STATS_PHASE_PARSE, STATS_PHASE_READ, &lap, reader->readNanoseconds, readStart, reader->bytesRead - bytesRead);
+
+        // Apply Butterworth filter
+        butterworthFilterChannels(filters, numChannels, inputBuffer, outputBuffer, (size_t)count);
+        *numSamples += (size_t)count;
+        statsLap(stats, STATS_PHASE_FILTER, &lap, (uint64_t)count * sizeof(uint16_t));
+        if (check != NULL)
+        {
+            filterCheckBlock(check, numChannels, inputBuffer, outputBuffer, (size_t)count);
+            lap = stats != NULL ? statsNow() : 0; // --verify is not a phase of the run
+        }
+
+        // Write output samples to file, a pipe gets every block as soon as it is filtered
+        uint64_t writeStart = writer->writeNanoseconds, bytesWritten = writer->bytesWritten;
+        if (sampleWriterWrite(writer, outputBuffer, (size_t)count) < 0 || (flushBlocks && sampleWriterFlush(writer) < 0))
+        {
+            return FILTER_WRITE_ERROR;
+        }
+        statsLapIo(stats, STATS_PHASE_FORMAT, STATS_PHASE_WRITE, &lap, writer->writeNanoseconds, writeStart,
+                   writer->bytesWritten - bytesWritten);
+        readStart = reader->readNanoseconds;
+        bytesRead = reader->bytesRead;
+    }
+    return count < 0 ? FILTER_READ_ERROR : 0;
+}
+
+// Print the message for a filterSamples error, prefixed with the file name when one is given
+static void printFilterError(int error, const SampleReader *reader, const char *path)
+{
+    const char *prefix = path == NULL ? "" : path;
+    const char *separator = path == NULL ? "" : ": ";
+    if (error == FILTER_WRITE_ERROR)
+    {
+        fprintf(stderr, "%s%sError writing output samples\n", prefix, separator);
+    }
+    else if (reader->format == SAMPLE_FORMAT_TEXT)
+    {
+        fprintf(stderr, "%s%sError reading input sample at line %zu\n", prefix, separator, reader->line);
+    }
+    else
+    {
+        fprintf(stderr, "%s%sError reading input sample %zu\n", prefix, separator, reader->line);
+    }
+}
+
+// Write the --stats JSON to its own file, so it does not mix with the messages on standard error. Returns 0 or -1.
+static int writeStats(const FilterOptions *options, uint64_t numSamples, unsigned numChannels)
+{
+    if (options->stats == NULL)
+    {
+        return 0;
+    }
+    FILE *file = strcmp(options->statsPath, "-") == 0 ? stdout : fopen(options->statsPath, "w");
+    int status = file == NULL || statsPrint(options->stats, file, numSamples, numChannels) < 0 ? -1 : 0;
+    if (file != NULL && file != stdout && fclose(file) != 0)
+    {
+        status = -1;
+    }
+    if (status < 0)
+    {
+        fprintf(stderr, "Failed to write the stats to %s\n", options->statsPath);
+    }
+    return status;
+}
+
+// Parse, filter and write the input one block at a time. Returns the exit status of the program.
+static int filterStream(const FilterOptions *options)
+{
+    uint64_t lap = options->stats != NULL ? statsNow() : 0;
+    SampleReader inputFile;
+    int inputStatus = sampleReaderOpen(&inputFile, options->inputPath, options->blockSize, options->inputFormat);
+    statsLap(options->stats, STATS_PHASE_READ, &lap, inputStatus < 0 ? 0 : inputFile.bytesRead);
+    SampleWriter outputFile;
+    int outputStatus = inputStatus < 0 ? -1 : openOutput(&outputFile, options, options->outputPath, &inputFile, NULL);
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, 0);
+
+    if (inputStatus < 0 || outputStatus < 0)
+    {
+        fprintf(stderr, "Failed to open input or output file\n");
+        return 1;
+    }
+
+    // The working set is split evenly between the input and output blocks, so memory use is fixed
+    // regardless of the length of the recording. Samples are parsed, filtered and written one block at a time.
+    unsigned numChannels = inputFile.layout.channels;
+    size_t blockSamples = frameBlockSamples(options->blockSize, numChannels);
+    uint16_t *inputBuffer = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+    uint16_t *outputBuffer = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+
+    if (inputBuffer == NULL || outputBuffer == NULL)
+    {
+        fprintf(stderr, "Failed to allocate sample buffers\n");
+        return 1;
+    }
+
+    // Initialize a filter per channel, their state carries over between blocks
+    ButterworthFilter filters[SAMPLE_MAX_CHANNELS];
+    for (unsigned channel = 0; channel < numChannels; channel++)
+    {
+        filters[channel] = options->design;
+    }
+
+    // The reference for --verify is the same design on the scalar kernel
+    FilterCheck check;
+    if (options->verify)
+    {
+        memset(&check, 0, sizeof(check));
+        for (unsigned channel = 0; channel < numChannels; channel++)
+        {
+            check.filters[channel] = options->design;
+            check.filters[channel].kernel = FILTER_KERNEL_SCALAR;
+        }
+        check.output = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+        if (check.output == NULL)
+        {
+            fprintf(stderr, "Failed to allocate sample buffers\n");
+            return 1;
+        }
+    }
+
+    statsLap(options->stats, STATS_PHASE_INIT, &lap, 0);
+    inputFile.timed = outputFile.timed = options->stats != NULL;
+    size_t numSamples;
+    int error = filterSamples(&inputFile, &outputFile, filters, inputBuffer, outputBuffer, blockSamples,
+                              strcmp(options->outputPath, "-") == 0, options->verify ? &check : NULL, options->stats, &numSamples);
+    if (error < 0)
+    {
+        printFilterError(error, &inputFile, NULL);
+        return 1;
+    }
+
+    int status = 0;
+    if (options->verify)
+    {
+        unsigned bound = butterworthFilterDeviationBound(&options->design);
+        fprintf(stderr, "Verify: %zu samples, %zu differ from the scalar kernel, by up to %u LSB, the bound is %u LSB\n",
+                check.numSamples, check.numDiffering, check.maxDeviation, bound);
+        if (check.maxDeviation > bound)
+        {
+            fprintf(stderr, "Verify: the deviation is out of bounds\n");
+            status = 1;
+        }
+        free(check.output);
+    }
+
+    // Cleanup, closing the output writes out the last of the buffered samples
+    lap = options->stats != NULL ? statsNow() : 0;
+    sampleReaderClose(&inputFile);
+    free(inputBuffer);
+    free(outputBuffer);
+    uint64_t bytesWritten = outputFile.bytesWritten;
+    if (sampleWriterClose(&outputFile) < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, outputFile.bytesWritten - bytesWritten);
+
+    if (options->stats != NULL)
+    {
+        // Parsing and formatting go through every byte read and written
+        options->stats->bytes[STATS_PHASE_PARSE] = options->stats->bytes[STATS_PHASE_READ];
+        options->stats->bytes[STATS_PHASE_FORMAT] = options->stats->bytes[STATS_PHASE_WRITE];
+    }
+    if (writeStats(options, numSamples, numChannels) < 0)
+    {
+        return 1;
+    }
+    return status;
+}
+
+// Filter a binary file straight from its memory mapping into a mapping of the output file.
+// Returns the exit status of the program, or -1 if the files are not binary and have to be streamed instead.
+static int filterMapped(const FilterOptions *options)
+{
+    if (options->outputFormat == SAMPLE_FORMAT_TEXT || options->outputFormat == SAMPLE_FORMAT_WAV ||
+        strcmp(options->inputPath, "-") == 0 || strcmp(options->outputPath, "-") == 0)
+    {
+        return -1;
+    }
+
+    // Reading maps the input and writing creates and unmaps the output, the page faults that move the samples fall in
+    // the filter phase and the kernel writes the pages back after the run
+    uint64_t lap = options->stats != NULL ? statsNow() : 0;
+    SampleMap inputMap;
+    int inputStatus = sampleMapOpen(&inputMap, options->inputPath, options->inputFormat);
+    if (inputStatus > 0)
+    {
+        return -1; // Text or WAV input
+    }
+    statsLap(options->stats, STATS_PHASE_READ, &lap, inputStatus == 0 ? inputMap.size : 0);
+
+    // Creating the output truncates it, which would zero the mapped input if both are the same file
+    struct stat inputInfo, outputInfo;
+    if (inputStatus == 0 && fstat(inputMap.fd, &inputInfo) == 0 && stat(options->outputPath, &outputInfo) == 0 &&
+        inputInfo.st_dev == outputInfo.st_dev && inputInfo.st_ino == outputInfo.st_ino)
+    {
+        fprintf(stderr, "The output would overwrite the input, --mmap needs a separate output file\n");
+        sampleMapClose(&inputMap);
+        return 1;
+    }
+
+    SampleMap outputMap;
+    if (inputStatus < 0 || sampleMapCreate(&outputMap, options->outputPath, options->outputFormat, options->outputHeader, inputMap.numSamples) < 0)
+    {
+        fprintf(stderr, "Failed to map input or output file\n");
+        sampleMapClose(&inputMap);
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, 0);
+
+    // The filter reads directly from the input pages and writes directly into the output pages
+    ButterworthFilter filter = options->design;
+    uint16_t inputOffset = sampleFormatOffset(inputMap.format);
+    uint16_t outputOffset = sampleFormatOffset(outputMap.format);
+
+    if (options->threads > 1)
+    {
+        butterworthFilterParallel(&filter, inputMap.samples, outputMap.samples, inputMap.numSamples, inputOffset, outputOffset,
+                                  options->threads, options->overlap);
+    }
+    else
+    {
+        butterworthFilterBlock(&filter, inputMap.samples, outputMap.samples, inputMap.numSamples, inputOffset, outputOffset);
+    }
+    statsLap(options->stats, STATS_PHASE_FILTER, &lap, inputMap.numSamples * sizeof(uint16_t));
+
+    // --verify compares the chunked output with the whole channel filtered on one thread by the scalar kernel
+    int status = 0;
+    if (options->verify)
+    {
+        FilterCheck check;
+        memset(&check, 0, sizeof(check));
+        check.filters[0] = options->design;
+        check.filters[0].kernel = FILTER_KERNEL_SCALAR;
+        check.output = (uint16_t *)malloc((inputMap.numSamples + 1) * sizeof(uint16_t));
+        if (check.output == NULL)
+        {
+            fprintf(stderr, "Failed to allocate sample buffers\n");
+            return 1;
+        }
+        butterworthFilterBlock(&check.filters[0], inputMap.samples, check.output, inputMap.numSamples, inputOffset, outputOffset);
+        filterCheckCompare(&check, outputMap.samples, inputMap.numSamples);
+        free(check.output);
+
+        unsigned bound = butterworthFilterDeviationBound(&options->design); // The fix-up is exact, (NOTE: 7)
+        fprintf(stderr, "Verify: %zu samples, %zu differ from the sequential scalar output, by up to %u LSB", check.numSamples,
+                check.numDiffering, check.maxDeviation);
+        if (options->overlap > 0)
+        {
+            fprintf(stderr, ", no bound with an overlap\n");
+        }
+        else
+        {
+            fprintf(stderr, ", the bound is %u LSB\n", bound);
+            if (check.maxDeviation > bound)
+            {
+                fprintf(stderr, "Verify: the deviation is out of bounds\n");
+                status = 1;
+            }
+        }
+    }
+
+    lap = options->stats != NULL ? statsNow() : 0; // --verify is not a phase of the run
+    sampleMapClose(&inputMap);
+    statsLap(options->stats, STATS_PHASE_READ, &lap, 0);
+    size_t numSamples = outputMap.numSamples, outputBytes = outputMap.size;
+    if (sampleMapClose(&outputMap) < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, outputBytes);
+    if (writeStats(options, numSamples, 1) < 0)
+    {
+        return 1;
+    }
+    return status;
+}
+
+// Filter and sample conversion for the io_uring path, each chunk continues where the previous one stopped
+typedef struct UringFilter
+{
+    ButterworthFilter filter;
+    uint16_t inputOffset;
+    uint16_t outputOffset;
+    PhaseStats *stats; // Time of the filter phase, NULL without --stats
+} UringFilter;
+
+static void uringFilterChunk(void *context, const unsigned char *in, unsigned char *out, size_t bytes)
+{
+    UringFilter *uring = (UringFilter *)context;
+    uint64_t lap = uring->stats != NULL ? statsNow() : 0;
+    butterworthFilterBlock(&uring->filter, (const uint16_t *)in, (uint16_t *)out, bytes / sizeof(uint16_t),
+                           uring->inputOffset, uring->outputOffset);
+    statsLap(uring->stats, STATS_PHASE_FILTER, &lap, bytes);
+}
+
+// Read every sample of the input into one buffer, which grows as needed. Returns the number of samples, or -1.
+static long readAllSamples(SampleReader *reader, uint16_t **samples)
+{
+    size_t capacity = 1 << 16, numSamples = 0;
+    *samples = (uint16_t *)malloc(capacity * sizeof(uint16_t));
+    long count = 0;
+    while (*samples != NULL && (count = sampleReaderRead(reader, *samples + numSamples, capacity - numSamples)) > 0)
+    {
+        numSamples += (size_t)count;
+        if (capacity - numSamples < SAMPLE_MAX_CHANNELS)
+        {
+            uint16_t *grown = (uint16_t *)realloc(*samples, 2 * capacity * sizeof(uint16_t));
+            if (grown == NULL)
+            {
+                free(*samples);
+            }
+            *samples = grown;
+            capacity *= 2;
+        }
+    }
+    return *samples == NULL || count < 0 ? -1 : (long)numSamples;
+}
+
+// Filter every channel of interleaved frames forward and backward, in place, (NOTE: 8). Returns 0 or -1 if out of memory.
+static int zeroPhaseChannels(const ButterworthFilter *design, uint16_t *samples, size_t numSamples, unsigned numChannels, unsigned numThreads)
+{
+    size_t numFrames = numSamples / numChannels;
+    size_t padding = ZERO_PHASE_PADDING(design->order);
+    fixedpoint_t *work = (fixedpoint_t *)malloc((numFrames + 2 * padding) * sizeof(fixedpoint_t));
+    if (work == NULL)
+    {
+        return -1;
+    }
+    for (unsigned channel = 0; channel < numChannels && numFrames > 0; channel++)
+    {
+        butterworthFilterZeroPhasePad(samples + channel, numFrames, numChannels, 0, padding, work);
+        if (butterworthFilterZeroPhase(design, work, numFrames + 2 * padding, numThreads) < 0)
+        {
+            free(work);
+            return -1;
+        }
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            samples[i * numChannels + channel] = fixedpoint_to_uint16(work[padding + i]);
+        }
+    }
+    free(work);
+    return 0;
+}
+
+// Zero phase filtering of a whole file in memory, with the forward and backward passes overlapped on --threads
+static int filterZeroPhase(const FilterOptions *options)
+{
+    uint64_t lap = options->stats != NULL ? statsNow() : 0;
+    SampleReader inputFile;
+    if (sampleReaderOpen(&inputFile, options->inputPath, options->blockSize, options->inputFormat) < 0)
+    {
+        fprintf(stderr, "Failed to open input file\n");
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_READ, &lap, inputFile.bytesRead);
+    inputFile.timed = options->stats != NULL;
+    uint64_t bytesRead = inputFile.bytesRead;
+    uint16_t *samples;
+    long numSamples = readAllSamples(&inputFile, &samples);
+    if (numSamples < 0)
+    {
+        printFilterError(FILTER_READ_ERROR, &inputFile, NULL);
+        return 1;
+    }
+    statsLapIo(options->stats, STATS_PHASE_PARSE, STATS_PHASE_READ, &lap, inputFile.readNanoseconds, 0, inputFile.bytesRead - bytesRead);
+
+    unsigned numChannels = inputFile.layout.channels;
+    uint16_t *reference = NULL;
+    if (options->verify)
+    {
+        // The reference is the same filter on one thread
+        reference = (uint16_t *)malloc(((size_t)numSamples + 1) * sizeof(uint16_t));
+        if (reference != NULL)
+        {
+            memcpy(reference, samples, (size_t)numSamples * sizeof(uint16_t));
+        }
+    }
+    lap = options->stats != NULL ? statsNow() : 0;
+    int filtered = (!options->verify || reference != NULL) &&
+                   zeroPhaseChannels(&options->design, samples, (size_t)numSamples, numChannels, options->threads) == 0;
+    statsLap(options->stats, STATS_PHASE_FILTER, &lap, (uint64_t)numSamples * sizeof(uint16_t));
+    if (!filtered || (reference != NULL && zeroPhaseChannels(&options->design, reference, (size_t)numSamples, numChannels, 1) < 0))
+    {
+        fprintf(stderr, "Failed to allocate sample buffers\n");
+        return 1;
+    }
+
+    int status = 0;
+    if (reference != NULL)
+    {
+        FilterCheck check;
+        memset(&check, 0, sizeof(check));
+        check.output = reference;
+        filterCheckCompare(&check, samples, (size_t)numSamples);
+        unsigned bound = 0; // The fix-up is exact and both runs use the same kernel, (NOTE: 8)
+        fprintf(stderr, "Verify: %zu samples, %zu differ from the zero phase output on one thread, by up to %u LSB, the bound is %u LSB\n",
+                check.numSamples, check.numDiffering, check.maxDeviation, bound);
+        if (check.maxDeviation > bound)
+        {
+            fprintf(stderr, "Verify: the deviation is out of bounds\n");
+            status = 1;
+        }
+        free(reference);
+    }
+
+    lap = options->stats != NULL ? statsNow() : 0; // --verify is not a phase of the run
+    SampleWriter outputFile;
+    if (openOutput(&outputFile, options, options->outputPath, &inputFile, NULL) < 0)
+    {
+        fprintf(stderr, "Failed to open output file\n");
+        return 1;
+    }
+    sampleReaderClose(&inputFile);
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, 0);
+    outputFile.timed = options->stats != NULL;
+    uint64_t bytesWritten = outputFile.bytesWritten;
+    if (sampleWriterWrite(&outputFile, samples, (size_t)numSamples) < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+    statsLapIo(options->stats, STATS_PHASE_FORMAT, STATS_PHASE_WRITE, &lap, outputFile.writeNanoseconds, 0,
+               outputFile.bytesWritten - bytesWritten);
+    bytesWritten = outputFile.bytesWritten;
+    if (sampleWriterClose(&outputFile) < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, outputFile.bytesWritten - bytesWritten);
+    free(samples);
+    if (options->stats != NULL)
+    {
+        // Parsing and formatting go through every byte read and written
+        options->stats->bytes[STATS_PHASE_PARSE] = options->stats->bytes[STATS_PHASE_READ];
+        options->stats->bytes[STATS_PHASE_FORMAT] = options->stats->bytes[STATS_PHASE_WRITE];
+    }
+    if (writeStats(options, (uint64_t)numSamples, numChannels) < 0)
+    {
+        return 1;
+    }
+    return status;
+}
+
+// Filter a binary file with reads and writes queued through io_uring, so the filter only waits on the disk when every
+// buffer is in use. Returns the exit status of the program, or -1 if the files have to be streamed instead.
+static int filterUring(const FilterOptions *options)
+{
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    return -1; // Samples would have to be byte swapped
+#endif
+    if (options->outputFormat == SAMPLE_FORMAT_TEXT || options->outputFormat == SAMPLE_FORMAT_WAV ||
+        options->inputFormat == SAMPLE_FORMAT_TEXT || options->inputFormat == SAMPLE_FORMAT_WAV || strcmp(options->inputPath, "-") == 0 || strcmp(options->outputPath, "-") == 0)
+    {
+        return -1;
+    }
+
+    uint64_t lap = options->stats != NULL ? statsNow() : 0;
+    int inputFd = open(options->inputPath, O_RDONLY);
+    struct stat info;
+    unsigned char header[SAMPLE_PEEK_SIZE];
+    ssize_t headerLength = inputFd < 0 || fstat(inputFd, &info) < 0 ? -1 : pread(inputFd, header, sizeof(header), 0);
+    if (headerLength < 0)
+    {
+        fprintf(stderr, "Failed to open input or output file\n");
+        if (inputFd >= 0)
+        {
+            close(inputFd);
+        }
+        return 1;
+    }
+
+    // Detect the format the same way as the reader, text and WAV go through the reader
+    SampleFormat headerFormat = sampleHeaderFormat(header, (size_t)headerLength);
+    SampleFormat inputFormat = options->inputFormat == SAMPLE_FORMAT_AUTO ? headerFormat : options->inputFormat;
+    if (inputFormat == SAMPLE_FORMAT_TEXT || inputFormat == SAMPLE_FORMAT_WAV)
+    {
+        close(inputFd);
+        return -1;
+    }
+    off_t inputOffset = headerFormat == SAMPLE_FORMAT_TEXT ? 0 : SAMPLE_HEADER_SIZE;
+    size_t inputBytes = (size_t)(info.st_size - inputOffset);
+    if ((headerFormat != SAMPLE_FORMAT_TEXT && headerFormat != inputFormat) || inputBytes % sizeof(uint16_t) != 0)
+    {
+        fprintf(stderr, "Error reading input sample %zu\n", inputBytes / sizeof(uint16_t));
+        close(inputFd);
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_READ, &lap, (uint64_t)inputOffset);
+
+    int outputFd = open(options->outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    const char *outputHeader = options->outputFormat == SAMPLE_FORMAT_S16 ? SAMPLE_HEADER_S16 : SAMPLE_HEADER_U16;
+    off_t outputOffset = options->outputHeader ? SAMPLE_HEADER_SIZE : 0;
+    if (outputFd < 0 || (outputOffset > 0 && pwrite(outputFd, outputHeader, SAMPLE_HEADER_SIZE, 0) != SAMPLE_HEADER_SIZE))
+    {
+        fprintf(stderr, "Failed to open input or output file\n");
+        close(inputFd);
+        if (outputFd >= 0)
+        {
+            close(outputFd);
+        }
+        return 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, (uint64_t)outputOffset);
+
+    // Each chunk is the size of one block on the stream path, queueDepth of them are in flight each way
+    UringFilter uring;
+    uring.filter = options->design;
+    uring.inputOffset = sampleFormatOffset(inputFormat);
+    uring.outputOffset = sampleFormatOffset(options->outputFormat);
+    uring.stats = options->stats;
+    size_t chunkSize = options->blockSize / 2 & ~(size_t)(sizeof(uint16_t) - 1);
+    chunkSize = chunkSize < sizeof(uint16_t) ? sizeof(uint16_t) : chunkSize;
+
+    // The reads and writes run in the kernel alongside the filter, only the time spent waiting on them is their phase
+    UringStats stats;
+    stats.timed = options->stats != NULL;
+    int status = uringTransform(inputFd, inputOffset, inputBytes, outputFd, outputOffset, chunkSize, options->queueDepth,
+                                uringFilterChunk, &uring, &stats);
+    if (options->stats != NULL)
+    {
+        statsAdd(options->stats, STATS_PHASE_READ, stats.readWaitNanoseconds, inputBytes);
+        statsAdd(options->stats, STATS_PHASE_WRITE, stats.writeWaitNanoseconds, inputBytes);
+        lap = statsNow();
+    }
+    close(inputFd);
+    statsLap(options->stats, STATS_PHASE_READ, &lap, 0);
+    if (close(outputFd) < 0 && status == 0)
+    {
+        status = -1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, 0);
+
+    if (status > 0)
+    {
+        fprintf(stderr, "io_uring is not available, using read and write\n");
+        return -1;
+    }
+    else if (status < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+
+    fprintf(stderr, "io_uring: queue depth %u, %zu byte chunks, %s buffers\n", stats.queueDepth, chunkSize,
+            stats.fixedBuffers ? "registered" : "unregistered");
+    fprintf(stderr, "io_uring: %zu reads, %zu writes, peak %u requests in flight\n", stats.reads, stats.writes, stats.peakRequests);
+    fprintf(stderr, "io_uring: bytes in flight peak %zu, average %.0f\n", stats.peakBytes, stats.averageBytes);
+    return writeStats(options, inputBytes / sizeof(uint16_t), 1) < 0 ? 1 : 0;
+}
+
+// Shared state of the threaded pipeline. Blocks flow reader -> parsed -> filter -> filtered -> writer.
+typedef struct FilterPipeline
+{
+    SampleReader reader;
+    const ButterworthFilter *design; // Copied to start the filter of every channel
+    unsigned numChannels;
+    BlockRing parsed;   // Parsed input samples, produced by the reader thread
+    BlockRing filtered; // Filtered output samples, produced by the filter thread
+    size_t blockSamples;
+    PhaseStats *stats; // Each stage times its own phases, NULL without --stats
+    int abort;         // Set when a stage fails so the others stop waiting on it
+} FilterPipeline;
+
+// Reader stage, parses the input into blocks until the end of the file or an error
+static void *pipelineReader(void *arg)
+{
+    FilterPipeline *pipeline = (FilterPipeline *)arg;
+    long count;
+    do
+    {
+        SampleBlock *block = blockRingAcquire(&pipeline->parsed, &pipeline->abort);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        // The time waiting for a free block is not part of the phase
+        uint64_t lap = pipeline->stats != NULL ? statsNow() : 0;
+        uint64_t readStart = pipeline->reader.readNanoseconds, bytesRead = pipeline->reader.bytesRead;
+        count = sampleReaderRead(&pipeline->reader, block->samples, pipeline->blockSamples);
+        statsLapIo(pipeline->stats, STATS_PHASE_PARSE, STATS_PHASE_READ, &lap, pipeline->reader.readNanoseconds, readStart,
+                   pipeline->reader.bytesRead - bytesRead);
+        block->count = count;
+        blockRingPublish(&pipeline->parsed);
+    } while (count > 0);
+    return NULL;
+}
+
+// Filter stage, the filter state carries over between blocks
+static void *pipelineFilter(void *arg)
+{
+    FilterPipeline *pipeline = (FilterPipeline *)arg;
+    ButterworthFilter filters[SAMPLE_MAX_CHANNELS];
+    for (unsigned channel = 0; channel < pipeline->numChannels; channel++)
+    {
+        filters[channel] = *pipeline->design;
+    }
+
+    long count;
+    do
+    {
+        SampleBlock *input = blockRingPeek(&pipeline->parsed, &pipeline->abort);
+        SampleBlock *output = input == NULL ? NULL : blockRingAcquire(&pipeline->filtered, &pipeline->abort);
+        if (output == NULL)
+        {
+            return NULL;
+        }
+        count = input->count;
+        if (count > 0)
+        {
+            uint64_t lap = pipeline->stats != NULL ? statsNow() : 0;
+            butterworthFilterChannels(filters, pipeline->numChannels, input->samples, output->samples, (size_t)count);
+            statsLap(pipeline->stats, STATS_PHASE_FILTER, &lap, (uint64_t)count * sizeof(uint16_t));
+        }
+        output->count = count;
+        blockRingRelease(&pipeline->parsed);
+        blockRingPublish(&pipeline->filtered);
+    } while (count > 0);
+    return NULL;
+}
+
+// Run the stream path with parsing and filtering on their own threads, the calling thread writes the output.
+// Returns the exit status of the program.
+static int filterPipelined(const FilterOptions *options)
+{
+    uint64_t lap = options->stats != NULL ? statsNow() : 0;
+    FilterPipeline pipeline;
+    SampleWriter outputFile;
+    int inputStatus = sampleReaderOpen(&pipeline.reader, options->inputPath, options->blockSize, options->inputFormat);
+    statsLap(options->stats, STATS_PHASE_READ, &lap, inputStatus < 0 ? 0 : pipeline.reader.bytesRead);
+    int outputStatus = inputStatus < 0 ? -1 : openOutput(&outputFile, options, options->outputPath, &pipeline.reader, NULL);
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, 0);
+
+    if (inputStatus < 0 || outputStatus < 0)
+    {
+        fprintf(stderr, "Failed to open input or output file\n");
+        if (inputStatus >= 0)
+        {
+            sampleReaderClose(&pipeline.reader);
+        }
+        return 1;
+    }
+
+    pipeline.design = &options->design;
+    pipeline.numChannels = pipeline.reader.layout.channels;
+    pipeline.blockSamples = frameBlockSamples(options->blockSize, pipeline.numChannels);
+    pipeline.stats = options->stats;
+    pipeline.reader.timed = outputFile.timed = options->stats != NULL;
+    pipeline.abort = 0;
+    pipeline.filtered.slots = NULL;
+    int started = blockRingInit(&pipeline.parsed, PIPELINE_DEPTH, pipeline.blockSamples) == 0 &&
+                  blockRingInit(&pipeline.filtered, PIPELINE_DEPTH, pipeline.blockSamples) == 0;
+    if (!started)
+    {
+        fprintf(stderr, "Failed to allocate sample buffers\n");
+    }
+
+    pthread_t readerThread, filterThread;
+    if (started && pthread_create(&readerThread, NULL, pipelineReader, &pipeline) != 0)
+    {
+        fprintf(stderr, "Failed to start the pipeline threads\n");
+        started = 0;
+    }
+    else if (started && pthread_create(&filterThread, NULL, pipelineFilter, &pipeline) != 0)
+    {
+        fprintf(stderr, "Failed to start the pipeline threads\n");
+        __atomic_store_n(&pipeline.abort, 1, __ATOMIC_RELAXED);
+        pthread_join(readerThread, NULL);
+        started = 0;
+    }
+    if (!started)
+    {
+        sampleReaderClose(&pipeline.reader);
+        sampleWriterClose(&outputFile);
+        blockRingFree(&pipeline.parsed);
+        blockRingFree(&pipeline.filtered);
+        return 1;
+    }
+
+    // Writer stage
+    int pipeOutput = strcmp(options->outputPath, "-") == 0;
+    int status = 0;
+    size_t numSamples = 0;
+    long count;
+    do
+    {
+        SampleBlock *block = blockRingPeek(&pipeline.filtered, &pipeline.abort);
+        if (block == NULL)
+        {
+            break;
+        }
+        count = block->count;
+        lap = options->stats != NULL ? statsNow() : 0;
+        uint64_t writeStart = outputFile.writeNanoseconds, bytesWritten = outputFile.bytesWritten;
+        if (count > 0 && (sampleWriterWrite(&outputFile, block->samples, (size_t)count) < 0 || (pipeOutput && sampleWriterFlush(&outputFile) < 0)))
+        {
+            fprintf(stderr, "Error writing output samples\n");
+            status = 1;
+            count = -1;
+            __atomic_store_n(&pipeline.abort, 1, __ATOMIC_RELAXED);
+        }
+        statsLapIo(options->stats, STATS_PHASE_FORMAT, STATS_PHASE_WRITE, &lap, outputFile.writeNanoseconds, writeStart,
+                   outputFile.bytesWritten - bytesWritten);
+        numSamples += count > 0 ? (size_t)count : 0;
+        blockRingRelease(&pipeline.filtered);
+    } while (count > 0);
+
+    pthread_join(readerThread, NULL);
+    pthread_join(filterThread, NULL);
+
+    if (count < 0 && status == 0)
+    {
+        if (pipeline.reader.format == SAMPLE_FORMAT_TEXT)
+        {
+            fprintf(stderr, "Error reading input sample at line %zu\n", pipeline.reader.line);
+        }
+        else
+        {
+            fprintf(stderr, "Error reading input sample %zu\n", pipeline.reader.line);
+        }
+        status = 1;
+    }
+
+    lap = options->stats != NULL ? statsNow() : 0;
+    sampleReaderClose(&pipeline.reader);
+    blockRingFree(&pipeline.parsed);
+    blockRingFree(&pipeline.filtered);
+    uint64_t bytesWritten = outputFile.bytesWritten;
+    if (sampleWriterClose(&outputFile) < 0 && status == 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        status = 1;
+    }
+    statsLap(options->stats, STATS_PHASE_WRITE, &lap, outputFile.bytesWritten - bytesWritten);
+    if (options->stats != NULL)
+    {
+        // Parsing and formatting go through every byte read and written
+        options->stats->bytes[STATS_PHASE_PARSE] = options->stats->bytes[STATS_PHASE_READ];
+        options->stats->bytes[STATS_PHASE_FORMAT] = options->stats->bytes[STATS_PHASE_WRITE];
+    }
+    if (status == 0 && writeStats(options, numSamples, pipeline.numChannels) < 0)
+    {
+        status = 1;
+    }
+    return status;
+}
+
+// One file of a batch and its result
+typedef struct BatchFile
+{
+    char *inputPath;
+    char *outputPath;
+    size_t numSamples;
+    unsigned numChannels;
+    double seconds;
+    int status; // 0 on success, 1 if the file failed
+} BatchFile;
+
+// Shared state of the batch workers, files are handed out in order through next
+typedef struct BatchJob
+{
+    const FilterOptions *options;
+    BatchFile *files;
+    size_t numFiles;
+    size_t next;
+    ButterworthFilter initial; // Freshly initialized filter copied to reset every channel
+    pthread_mutex_t statsLock; // Held while a worker adds its phases to options->stats
+} BatchJob;
+
+static double monotonicSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Filter one file of a batch through the buffers of a worker. Returns 0 on success, 1 on failure.
+static int batchFilterFile(BatchJob *job, BatchFile *file, unsigned char *readBuffer, size_t readBufferSize, char *writeBuffer,
+                           uint16_t *inputBuffer, uint16_t *outputBuffer, ButterworthFilter *filters, PhaseStats *stats)
+{
+    const FilterOptions *options = job->options;
+    uint64_t lap = stats != NULL ? statsNow() : 0;
+    SampleReader inputFile;
+    if (sampleReaderOpenBuffer(&inputFile, file->inputPath, readBuffer, readBufferSize, options->inputFormat) < 0)
+    {
+        fprintf(stderr, "%s: Failed to open input file\n", file->inputPath);
+        return 1;
+    }
+    statsLap(stats, STATS_PHASE_READ, &lap, inputFile.bytesRead);
+
+    // Never truncate the file being read, e.g. when the output directory is the input directory
+    struct stat inputInfo, outputInfo;
+    if (fstat(inputFile.fd, &inputInfo) == 0 && stat(file->outputPath, &outputInfo) == 0 &&
+        inputInfo.st_dev == outputInfo.st_dev && inputInfo.st_ino == outputInfo.st_ino)
+    {
+        fprintf(stderr, "%s: The output would overwrite the input\n", file->inputPath);
+        sampleReaderClose(&inputFile);
+        return 1;
+    }
+
+    SampleWriter outputFile;
+    if (openOutput(&outputFile, options, file->outputPath, &inputFile, writeBuffer) < 0)
+    {
+        fprintf(stderr, "%s: Failed to open output file\n", file->outputPath);
+        sampleReaderClose(&inputFile);
+        return 1;
+    }
+    statsLap(stats, STATS_PHASE_WRITE, &lap, 0);
+    inputFile.timed = outputFile.timed = stats != NULL;
+
+    unsigned numChannels = inputFile.layout.channels;
+    file->numChannels = numChannels;
+    for (unsigned channel = 0; channel < numChannels; channel++)
+    {
+        filters[channel] = job->initial;
+    }
+
+    int error = filterSamples(&inputFile, &outputFile, filters, inputBuffer, outputBuffer,
+                              frameBlockSamples(options->blockSize, numChannels), 0, NULL, stats, &file->numSamples);
+    if (error < 0)
+    {
+        printFilterError(error, &inputFile, file->inputPath);
+    }
+    lap = stats != NULL ? statsNow() : 0;
+    sampleReaderClose(&inputFile);
+    uint64_t bytesWritten = outputFile.bytesWritten;
+    if (sampleWriterClose(&outputFile) < 0 && error == 0)
+    {
+        fprintf(stderr, "%s: Error writing output samples\n", file->outputPath);
+        error = FILTER_WRITE_ERROR;
+    }
+    statsLap(stats, STATS_PHASE_WRITE, &lap, outputFile.bytesWritten - bytesWritten);
+    return error < 0 ? 1 : 0;
+}
+
+// Batch worker, takes the next file until none are left. All buffers are allocated once and reused for every file.
+static void *batchWorker(void *arg)
+{
+    BatchJob *job = (BatchJob *)arg;
+    const FilterOptions *options = job->options;
+
+    // The read buffer has to hold a whole WAV frame and the sample blocks at least one frame
+    size_t readBufferSize = options->blockSize < SAMPLE_MAX_CHANNELS * sizeof(uint32_t) ? SAMPLE_MAX_CHANNELS * sizeof(uint32_t) : options->blockSize;
+    size_t writeBufferSize = options->blockSize < SAMPLE_MIN_BUFFER_SIZE ? SAMPLE_MIN_BUFFER_SIZE : options->blockSize;
+    size_t blockSamples = frameBlockSamples(options->blockSize, 1);
+    blockSamples = blockSamples < SAMPLE_MAX_CHANNELS ? SAMPLE_MAX_CHANNELS : blockSamples;
+    unsigned char *readBuffer = (unsigned char *)malloc(readBufferSize);
+    char *writeBuffer = (char *)malloc(writeBufferSize);
+    uint16_t *inputBuffer = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+    uint16_t *outputBuffer = (uint16_t *)malloc(blockSamples * sizeof(uint16_t));
+    ButterworthFilter filters[SAMPLE_MAX_CHANNELS];
+    int allocated = readBuffer != NULL && writeBuffer != NULL && inputBuffer != NULL && outputBuffer != NULL;
+    PhaseStats stats; // The phases of this worker, added to the others' once it is done
+    memset(&stats, 0, sizeof(stats));
+
+    for (;;)
+    {
+        size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (index >= job->numFiles)
+        {
+            break;
+        }
+
+        BatchFile *file = &job->files[index];
+        double start = monotonicSeconds();
+        file->status = allocated ? batchFilterFile(job, file, readBuffer, readBufferSize, writeBuffer, inputBuffer, outputBuffer, filters,
+                                                   options->stats != NULL ? &stats : NULL)
+                                 : 1;
+        file->seconds = monotonicSeconds() - start;
+    }
+    if (options->stats != NULL)
+    {
+        pthread_mutex_lock(&job->statsLock);
+        statsMerge(options->stats, &stats);
+        pthread_mutex_unlock(&job->statsLock);
+    }
+
+    free(readBuffer);
+    free(writeBuffer);
+    free(inputBuffer);
+    free(outputBuffer);
+    return NULL;
+}
+
+// Add a file to the batch, its output keeps its name in the output directory. Returns 0 on success, -1 on failure.
+static int batchAddFile(BatchFile **files, size_t *numFiles, size_t *capacity, const char *inputPath, const char *outputDirectory)
+{
+    if (*numFiles == *capacity)
+    {
+        size_t grown = *capacity == 0 ? 64 : 2 * *capacity;
+        BatchFile *resized = (BatchFile *)realloc(*files, grown * sizeof(BatchFile));
+        if (resized == NULL)
+        {
+            return -1;
+        }
+        *files = resized;
+        *capacity = grown;
+    }
+
+    const char *slash = strrchr(inputPath, '/');
+    const char *name = slash == NULL ? inputPath : slash + 1;
+    BatchFile *file = &(*files)[*numFiles];
+    memset(file, 0, sizeof(*file));
+    file->inputPath = (char *)malloc(strlen(inputPath) + 1);
+    file->outputPath = (char *)malloc(strlen(outputDirectory) + strlen(name) + 2);
+    if (file->inputPath == NULL || file->outputPath == NULL || *name == '\0')
+    {
+        free(file->inputPath);
+        free(file->outputPath);
+        return -1;
+    }
+    strcpy(file->inputPath, inputPath);
+    sprintf(file->outputPath, "%s/%s", outputDirectory, name);
+    (*numFiles)++;
+    return 0;
+}
+
+static int compareBatchFiles(const void *a, const void *b)
+{
+    return strcmp(((const BatchFile *)a)->inputPath, ((const BatchFile *)b)->inputPath);
+}
+
+// Collect the files of a batch from a directory (every regular file, in name order) or a list with one path per line
+// ("-" reads the list from standard input). Returns the number of files, or -1 on failure.
+static long batchCollectFiles(const char *source, const char *outputDirectory, BatchFile **files)
+{
+    size_t numFiles = 0, capacity = 0;
+    *files = NULL;
+
+    struct stat info;
+    if (strcmp(source, "-") != 0 && stat(source, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        DIR *directory = opendir(source);
+        if (directory == NULL)
+        {
+            return -1;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL)
+        {
+            char *path = (char *)malloc(strlen(source) + strlen(entry->d_name) + 2);
+            if (path == NULL)
+            {
+                closedir(directory);
+                return -1;
+            }
+            sprintf(path, "%s/%s", source, entry->d_name);
+            int status = stat(path, &info) == 0 && S_ISREG(info.st_mode) ? batchAddFile(files, &numFiles, &capacity, path, outputDirectory) : 0;
+            free(path);
+            if (status < 0)
+            {
+                closedir(directory);
+                return -1;
+            }
+        }
+        closedir(directory);
+        if (numFiles > 0)
+        {
+            qsort(*files, numFiles, sizeof(BatchFile), compareBatchFiles);
+        }
+        return (long)numFiles;
+    }
+
+    FILE *list = strcmp(source, "-") == 0 ? stdin : fopen(source, "r");
+    if (list == NULL)
+    {
+        return -1;
+    }
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t length;
+    int status = 0;
+    while (status == 0 && (length = getline(&line, &lineCapacity, list)) >= 0)
+    {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+        if (length > 0)
+        {
+            status = batchAddFile(files, &numFiles, &capacity, line, outputDirectory);
+        }
+    }
+    free(line);
+    if (list != stdin)
+    {
+        fclose(list);
+    }
+    return status < 0 ? -1 : (long)numFiles;
+}
+
+// Filter every file of a batch in this process on a pool of worker threads, then report the throughput.
+// Returns the exit status of the program, 1 if any file failed.
+static int filterBatch(const FilterOptions *options)
+{
+    if (mkdir(options->outputPath, 0755) < 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Failed to create output directory %s\n", options->outputPath);
+        return 1;
+    }
+
+    BatchJob job;
+    long numFiles = batchCollectFiles(options->inputPath, options->outputPath, &job.files);
+    if (numFiles < 0)
+    {
+        fprintf(stderr, "Failed to read the batch file list %s\n", options->inputPath);
+        return 1;
+    }
+    job.options = options;
+    job.numFiles = (size_t)numFiles;
+    job.next = 0;
+    job.initial = options->design;
+
+    long onlineCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned numWorkers = options->jobs != 0 ? options->jobs : (onlineCpus > 0 ? (unsigned)onlineCpus : 1);
+    numWorkers = job.numFiles < numWorkers ? (unsigned)job.numFiles : numWorkers;
+    pthread_t *workers = (pthread_t *)malloc((numWorkers > 0 ? numWorkers : 1) * sizeof(pthread_t));
+    if (workers == NULL)
+    {
+        fprintf(stderr, "Failed to start the batch workers\n");
+        return 1;
+    }
+
+    pthread_mutex_init(&job.statsLock, NULL);
+    double start = monotonicSeconds();
+    unsigned started = 0;
+    for (; started < numWorkers; started++)
+    {
+        if (pthread_create(&workers[started], NULL, batchWorker, &job) != 0)
+        {
+            break; // The workers already running pick up the remaining files
+        }
+    }
+    if (started == 0)
+    {
+        batchWorker(&job);
+    }
+    for (unsigned i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    double seconds = monotonicSeconds() - start;
+
+    // Per file and aggregate throughput, in list order
+    size_t totalSamples = 0, failed = 0;
+    unsigned numChannels = 0;
+    for (size_t i = 0; i < job.numFiles; i++)
+    {
+        BatchFile *file = &job.files[i];
+        if (file->status != 0)
+        {
+            fprintf(stderr, "%s: failed\n", file->inputPath);
+            failed++;
+        }
+        else
+        {
+            fprintf(stderr, "%s: %zu samples in %.3f ms, %.2f Msamples/s\n", file->inputPath, file->numSamples,
+                    file->seconds * 1e3, file->seconds > 0.0 ? (double)file->numSamples / file->seconds * 1e-6 : 0.0);
+            totalSamples += file->numSamples;
+            numChannels = file->numChannels > numChannels ? file->numChannels : numChannels;
+        }
+        free(file->inputPath);
+        free(file->outputPath);
+    }
+    fprintf(stderr, "Batch: %zu files (%zu failed) on %u workers, %zu samples in %.3f s, %.2f Msamples/s, %.1f files/s\n",
+            job.numFiles, failed, started > 0 ? started : 1, totalSamples, seconds,
+            seconds > 0.0 ? (double)totalSamples / seconds * 1e-6 : 0.0, seconds > 0.0 ? (double)job.numFiles / seconds : 0.0);
+
+    if (options->stats != NULL)
+    {
+        // Parsing and formatting go through every byte read and written
+        options->stats->bytes[STATS_PHASE_PARSE] = options->stats->bytes[STATS_PHASE_READ];
+        options->stats->bytes[STATS_PHASE_FORMAT] = options->stats->bytes[STATS_PHASE_WRITE];
+    }
+    int statsStatus = writeStats(options, totalSamples, numChannels);
+
+    pthread_mutex_destroy(&job.statsLock);
+    free(job.files);
+    free(workers);
+    return failed > 0 || statsStatus < 0 ? 1 : 0;
+}
+
+// Design the filter for the sampling rate and cutoff of the options, reusing the coefficients of an earlier run with the
+// same settings when they are in the cache. Returns 0 on success, -1 if the design does not fit the fixed point format.
+static int designFilter(FilterOptions *options)
+{
+    if (!butterworthFilterDesignable(options->samplingRate, options->cutoffFrequency, options->order))
+    {
+        if (options->order < MIN_ORDER || options->order > MAX_ORDER)
+        {
+            fprintf(stderr, "The order must be between %d and %d\n", MIN_ORDER, MAX_ORDER);
+        }
+        else
+        {
+            fprintf(stderr, "A cutoff of %g Hz at %g Hz can not be represented, it must be below half the sampling rate and above about 0.2%% of it\n",
+                    options->cutoffFrequency, options->samplingRate);
+        }
+        return -1;
+    }
+
+    CoefficientKey key = {options->samplingRate, options->cutoffFrequency, options->order, INTEGER_BITS, FRACTIONAL_BITS};
+    int numCoefficients = (int)((options->order + 1) / 2 * SECTION_COEFFICIENTS);
+    int32_t coefficients[MAX_SECTIONS * SECTION_COEFFICIENTS];
+    if (coefficientCacheLoad(options->coefficientCache, &key, coefficients, (size_t)numCoefficients) == numCoefficients)
+    {
+        butterworthFilterSetCoefficients(&options->design, coefficients, options->order);
+        return 0;
+    }
+
+    butterworthFilterInit(&options->design, options->samplingRate, options->cutoffFrequency, options->order);
+    butterworthFilterGetCoefficients(&options->design, coefficients);
+    if (coefficientCacheStore(options->coefficientCache, &key, coefficients, (size_t)numCoefficients) < 0)
+    {
+        fprintf(stderr, "Warning: failed to update the coefficient cache %s\n", options->coefficientCache);
+    }
+    return 0;
+}
+
+// Print specialized.h for the designed filter, (NOTE: 9)
+static void printSpecializedKernel(const FilterOptions *options)
+{
+    const ButterworthFilter *f = &options->design;
+    printf("/**\n");
+    printf(" * @file specialized.h\n");
+    printf(" * @brief Filter design compiled into the specialized kernel of butterworth.c\n");
+    printf(" * @details Generated by butterworth --emit-kernel -r %.17g -c %.17g -n %u, regenerate with make specialize.\n",
+           options->samplingRate, options->cutoffFrequency, options->order);
+    printf(" *          Q%d.%d coefficients of every section, SECTION(index, b0, b1, b2, a1, a2).\n", INTEGER_BITS, FRACTIONAL_BITS);
+    printf(" */\n\n");
+    printf("#ifndef _SPECIALIZED_H_\n#define _SPECIALIZED_H_\n\n");
+    printf("#define SPECIALIZED_SAMPLING_RATE %.17g\n", options->samplingRate);
+    printf("#define SPECIALIZED_CUTOFF_FREQUENCY %.17g\n", options->cutoffFrequency);
+    printf("#define SPECIALIZED_ORDER %u\n\n", options->order);
+    printf("#define SPECIALIZED_SECTIONS(SECTION)");
+    for (unsigned i = 0; i < f->numSections; i++)
+    {
+        const FilterSection *section = &f->sections[i];
+        printf(" \\\n    SECTION(%u, %ld, %ld, %ld, %ld, %ld)", i, (long)section->b0, (long)section->b1, (long)section->b2,
+               (long)section->a1, (long)section->a2);
+    }
+    printf("\n\n#endif // _SPECIALIZED_H_\n");
+}
+
+// Parse a frequency in Hertz. Returns 0 on success, -1 if the value is not a positive number.
+static int parseFrequency(const char *text, double *frequency)
+{
+    char *end;
+    *frequency = strtod(text, &end);
+    return *end != '\0' || end == text || !(*frequency > 0.0) ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    fprintf(stderr, "Applying Butterworth Filter\n");
+
+    // Parse the command line, options may appear anywhere before the file names
+    FilterOptions options;
+    PhaseStats stats;
+    memset(&options, 0, sizeof(options));
+    options.blockSize = DEFAULT_BLOCK_SIZE;
+    options.inputFormat = SAMPLE_FORMAT_AUTO;
+    options.outputFormat = SAMPLE_FORMAT_TEXT;
+    options.outputHeader = 1;
+    options.queueDepth = DEFAULT_QUEUE_DEPTH;
+    options.samplingRate = SAMPLING_RATE;
+    options.cutoffFrequency = CUTOFF_FREQUENCY;
+    options.order = ORDER;
+    options.threads = 1;
+    options.coefficientCache = getenv("BUTTERWORTH_COEFFICIENT_CACHE");
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--block-size") == 0) && i + 1 < argc)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || value < 2 * sizeof(uint16_t))
+            {
+                fprintf(stderr, "Invalid block size: %s\n", argv[i]);
+                return 1;
+            }
+            options.blockSize = value;
+        }
+        else if ((strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--input-format") == 0) && i + 1 < argc)
+        {
+            if (sampleFormatFromName(argv[++i], &options.inputFormat) < 0)
+            {
+                fprintf(stderr, "Unknown input format: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output-format") == 0) && i + 1 < argc)
+        {
+            if (sampleFormatFromName(argv[++i], &options.outputFormat) < 0 || options.outputFormat == SAMPLE_FORMAT_AUTO)
+            {
+                fprintf(stderr, "Unknown output format: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--no-header") == 0)
+        {
+            options.outputHeader = 0;
+        }
+        else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc)
+        {
+            options.outputBits = (unsigned)atoi(argv[++i]);
+            if (options.outputBits != 16 && options.outputBits != 24 && options.outputBits != 32)
+            {
+                fprintf(stderr, "Invalid sample width: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--mmap") == 0)
+        {
+            options.useMmap = 1;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            options.usePipeline = 1;
+        }
+        else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--sample-rate") == 0) && i + 1 < argc)
+        {
+            if (parseFrequency(argv[++i], &options.samplingRate) < 0)
+            {
+                fprintf(stderr, "Invalid sample rate: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cutoff") == 0) && i + 1 < argc)
+        {
+            if (parseFrequency(argv[++i], &options.cutoffFrequency) < 0)
+            {
+                fprintf(stderr, "Invalid cutoff frequency: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--order") == 0) && i + 1 < argc)
+        {
+            options.order = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--coefficient-cache") == 0 && i + 1 < argc)
+        {
+            options.coefficientCache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch") == 0)
+        {
+            options.batch = 1;
+        }
+        else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || value == 0 || value > 4096)
+            {
+                fprintf(stderr, "Invalid number of jobs: %s\n", argv[i]);
+                return 1;
+            }
+            options.jobs = (unsigned)value;
+        }
+        else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "uring") != 0 && strcmp(argv[i], "read") != 0)
+            {
+                fprintf(stderr, "Unknown I/O backend: %s\n", argv[i]);
+                return 1;
+            }
+            options.useUring = strcmp(argv[i], "uring") == 0;
+        }
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "auto") == 0)
+            {
+                options.kernel = FILTER_KERNEL_AUTO;
+            }
+            else if (strcmp(argv[i], "scalar") == 0)
+            {
+                options.kernel = FILTER_KERNEL_SCALAR;
+            }
+            else if (strcmp(argv[i], "lookahead") == 0)
+            {
+                options.kernel = FILTER_KERNEL_LOOKAHEAD;
+            }
+            else if (strcmp(argv[i], "tdf2") == 0)
+            {
+                options.kernel = FILTER_KERNEL_TDF2;
+            }
+            else if (strcmp(argv[i], "int16") == 0)
+            {
+                options.kernel = FILTER_KERNEL_INT16;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown filter kernel: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)
+        {
+            unsigned features;
+            if (cpuFeaturesFromName(argv[++i], &features) < 0)
+            {
+                fprintf(stderr, "Unknown CPU feature level: %s\n", argv[i]);
+                return 1;
+            }
+            cpuFeaturesRestrict(features);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || value == 0 || value > PARALLEL_MAX_THREADS)
+            {
+                fprintf(stderr, "Invalid number of threads: %s\n", argv[i]);
+                return 1;
+            }
+            options.threads = (unsigned)value;
+        }
+        else if (strcmp(argv[i], "--overlap") == 0 && i + 1 < argc)
+        {
+            char *end;
+            options.overlap = strtoul(argv[++i], &end, 10);
+            if (*end != '\0')
+            {
+                fprintf(stderr, "Invalid overlap: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--zero-phase") == 0)
+        {
+            options.zeroPhase = 1;
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            options.verify = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            options.stats = &stats;
+            options.statsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--emit-kernel") == 0)
+        {
+            options.emitKernel = 1;
+        }
+        else if (strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || value == 0 || value > 1024)
+            {
+                fprintf(stderr, "Invalid queue depth: %s\n", argv[i]);
+                return 1;
+            }
+            options.queueDepth = (unsigned)value;
+        }
+        else if (options.inputPath == NULL)
+        {
+            options.inputPath = argv[i];
+        }
+        else if (options.outputPath == NULL)
+        {
+            options.outputPath = argv[i];
+        }
+    }
+
+    // Generating specialized.h needs the design only
+    if (options.emitKernel)
+    {
+        if (designFilter(&options) < 0)
+        {
+            return 1;
+        }
+        printSpecializedKernel(&options);
+        return 0;
+    }
+
+    if (options.inputPath == NULL || options.outputPath == NULL)
+    {
+        fprintf(stderr, "Usage: %s [options] <input_file> <output_file>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --batch <file_list|directory> <output_directory>\n", argv[0]);
+        fprintf(stderr, "  Use - as the input or output file to read standard input or write standard output\n");
+        fprintf(stderr, "  -r, --sample-rate <hz>       Sampling rate the filter is designed for (default: %d)\n", SAMPLING_RATE);
+        fprintf(stderr, "  -c, --cutoff <hz>            Cutoff frequency of the filter (default: %d)\n", CUTOFF_FREQUENCY);
+        fprintf(stderr, "  -n, --order <n>              Order of the filter, %d to %d (default: %d)\n", MIN_ORDER, MAX_ORDER, ORDER);
+        fprintf(stderr, "      --coefficient-cache <f>  File caching designed coefficients between runs (default: $BUTTERWORTH_COEFFICIENT_CACHE)\n");
+        fprintf(stderr, "      --kernel <kernel>        auto, scalar, lookahead, tdf2 or int16, auto filters 8 or more channels with SIMD (default: auto)\n");
+        fprintf(stderr, "      --cpu <level>            Use at most portable, x86-64, avx2 or avx512 kernels (default: all the CPU has)\n");
+        fprintf(stderr, "      --threads <n>            Split one binary channel into chunks filtered on n threads, up to %d\n", PARALLEL_MAX_THREADS);
+        fprintf(stderr, "      --overlap <samples>      Warm up each chunk on the samples before it instead of fixing up its start\n");
+        fprintf(stderr, "      --zero-phase             Filter forward and then backward in memory, for no phase shift (filtfilt)\n");
+        fprintf(stderr, "      --verify                 Compare the output with the scalar kernel, fail if it is further off than the kernel's bound\n");
+        fprintf(stderr, "      --stats <file>           Write the time, throughput and peak memory of each phase as JSON to a file, - for standard output\n");
+        fprintf(stderr, "      --emit-kernel            Print specialized.h for the design instead of filtering, see make specialize\n");
+        fprintf(stderr, "  -b, --block-size <bytes>     Working set used for the sample blocks (default: %d)\n", DEFAULT_BLOCK_SIZE);
+        fprintf(stderr, "  -i, --input-format <format>  auto, text, u16, s16 or wav (default: auto)\n");
+        fprintf(stderr, "  -o, --output-format <format> text, u16, s16 or wav (default: text)\n");
+        fprintf(stderr, "      --no-header              Write binary output as raw PCM without a header\n");
+        fprintf(stderr, "      --bits <16|24|32>        Sample width of WAV output (default: that of a WAV input, otherwise 16)\n");
+        fprintf(stderr, "      --mmap                   Filter binary files directly through memory mappings\n");
+        fprintf(stderr, "      --pipeline               Parse, filter and write on separate threads\n");
+        fprintf(stderr, "      --io <backend>           read or uring, uring queues binary file I/O asynchronously (default: read)\n");
+        fprintf(stderr, "      --queue-depth <n>        Blocks kept in flight each way by the uring backend (default: %d)\n", DEFAULT_QUEUE_DEPTH);
+        fprintf(stderr, "      --batch                  Filter every file of a list (one path per line) or directory into a directory\n");
+        fprintf(stderr, "  -j, --jobs <n>               Worker threads for --batch (default: one per CPU)\n");
+        return 1;
+    }
+
+    if (options.stats != NULL && strcmp(options.statsPath, "-") == 0 && strcmp(options.outputPath, "-") == 0)
+    {
+        fprintf(stderr, "--stats - and the output would both go to standard output\n");
+        return 1;
+    }
+    uint64_t lap = 0;
+    if (options.stats != NULL)
+    {
+        statsBegin(options.stats);
+        lap = options.stats->start;
+    }
+    if (designFilter(&options) < 0)
+    {
+        return 1;
+    }
+    options.design.kernel = options.kernel;
+    if (options.kernel == FILTER_KERNEL_LOOKAHEAD)
+    {
+        butterworthLookaheadInit(&options.lookahead, &options.design);
+        options.design.lookahead = &options.lookahead;
+    }
+    if (options.kernel == FILTER_KERNEL_INT16 && !butterworthFilterInt16Fits(&options.design))
+    {
+        fprintf(stderr, "The coefficients of this design do not fit the int16 kernel, the cutoff is too close to half the sampling rate\n");
+        return 1;
+    }
+    if (options.kernel == FILTER_KERNEL_INT16 && options.zeroPhase)
+    {
+        fprintf(stderr, "--zero-phase keeps the samples in fixed point between the passes, it can not use the int16 kernel\n");
+        return 1;
+    }
+
+    statsLap(options.stats, STATS_PHASE_INIT, &lap, 0);
+    // Verification compares every block on the streaming path, or the whole channel on the mapped path
+    if ((options.verify || options.zeroPhase) && options.batch)
+    {
+        fprintf(stderr, "--verify and --zero-phase filter a single file, not a --batch\n");
+        return 1;
+    }
+    if (options.verify && (options.useUring || options.usePipeline))
+    {
+        fprintf(stderr, "--verify compares the output on the streaming or mapped path, not with --io uring or --pipeline\n");
+        return 1;
+    }
+
+    int status = -1;
+    if (options.zeroPhase)
+    {
+        status = filterZeroPhase(&options);
+    }
+    if (status < 0 && options.batch)
+    {
+        status = filterBatch(&options);
+    }
+    if (status < 0 && (options.useMmap || options.threads > 1))
+    {
+        status = filterMapped(&options);
+        if (status < 0 && options.threads > 1)
+        {
+            fprintf(stderr, "Warning: --threads needs binary input and output files, filtering on one thread\n");
+        }
+    }
+    if (status < 0 && options.useUring)
+    {
+        status = filterUring(&options);
+    }
+    if (status < 0 && options.usePipeline)
+    {
+        status = filterPipelined(&options);
+    }
+    if (status < 0)
+    {
+        status = filterStream(&options);
+    }
+
+    if (status == 0)
+    {
+        fprintf(stderr, "Finished Applying Butterworth Filter\n");
+    }
+    return status;
+}
+
+#endif // BUTTERWORTH_LIBRARY
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "coeffcache.h"
+
+/*
+(NOTE: 1):  The cache file is text, one design per line: "bwcoef <sample rate> <cutoff> <order> Q<int>.<frac> <count>"
+            followed by the coefficients as raw fixed point integers. Rates are written with 17 significant digits so
+            they read back to the same double and the key compares exactly.
+
+(NOTE: 2):  A new design is appended with a single write() on a file opened with O_APPEND, so concurrent runs never
+            interleave their lines. A line that does not parse (e.g. cut short by a full disk) is skipped.
+*/
+
+#define MEMORY_ENTRIES 16  // Designs remembered in memory, the oldest is replaced when full
+#define MAX_LINE_SIZE 1024 // Longest line written to the cache file
+
+typedef struct CacheEntry
+{
+    CoefficientKey key;
+    size_t numCoefficients;
+    int32_t coefficients[COEFFICIENT_CACHE_MAX];
+} CacheEntry;
+
+static CacheEntry memoryEntries[MEMORY_ENTRIES];
+static size_t memoryCount = 0;
+static pthread_mutex_t memoryLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int keysEqual(const CoefficientKey *a, const CoefficientKey *b)
+{
+    return a->sampleRate == b->sampleRate && a->cutoffFrequency == b->cutoffFrequency && a->order == b->order &&
+           a->integerBits == b->integerBits && a->fractionalBits == b->fractionalBits;
+}
+
+static void memoryStore(const CoefficientKey *key, const int32_t *coefficients, size_t numCoefficients)
+{
+    pthread_mutex_lock(&memoryLock);
+    CacheEntry *entry = &memoryEntries[memoryCount % MEMORY_ENTRIES];
+    entry->key = *key;
+    entry->numCoefficients = numCoefficients;
+    memcpy(entry->coefficients, coefficients, numCoefficients * sizeof(int32_t));
+    memoryCount++;
+    pthread_mutex_unlock(&memoryLock);
+}
+
+static int memoryLoad(const CoefficientKey *key, int32_t *coefficients, size_t maxCoefficients)
+{
+    int result = -1;
+    pthread_mutex_lock(&memoryLock);
+    size_t numEntries = memoryCount < MEMORY_ENTRIES ? memoryCount : MEMORY_ENTRIES;
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        CacheEntry *entry = &memoryEntries[i];
+        if (keysEqual(&entry->key, key) && entry->numCoefficients <= maxCoefficients)
+        {
+            memcpy(coefficients, entry->coefficients, entry->numCoefficients * sizeof(int32_t));
+            result = (int)entry->numCoefficients;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&memoryLock);
+    return result;
+}
+
+// Parse one line of the cache file, (NOTE: 1). Returns the number of coefficients, or -1 if the line is malformed.
+static int parseLine(char *line, CoefficientKey *key, int32_t *coefficients)
+{
+    int consumed = 0;
+    unsigned numCoefficients;
+    if (sscanf(line, "bwcoef %lf %lf %u Q%u.%u %u%n", &key->sampleRate, &key->cutoffFrequency, &key->order,
+               &key->integerBits, &key->fractionalBits, &numCoefficients, &consumed) != 6 ||
+        numCoefficients > COEFFICIENT_CACHE_MAX)
+    {
+        return -1;
+    }
+
+    char *p = line + consumed;
+    for (unsigned i = 0; i < numCoefficients; i++)
+    {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < INT32_MIN || value > INT32_MAX)
+        {
+            return -1;
+        }
+        coefficients[i] = (int32_t)value;
+        p = end;
+    }
+    return *p == '\n' || *p == '\0' ? (int)numCoefficients : -1;
+}
+
+int coefficientCacheLoad(const char *path, const CoefficientKey *key, int32_t *coefficients, size_t maxCoefficients)
+{
+    int result = memoryLoad(key, coefficients, maxCoefficients);
+    if (result >= 0 || path == NULL)
+    {
+        return result;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    // The last matching line wins, so a design can be corrected by appending it again
+    char line[MAX_LINE_SIZE];
+    CoefficientKey lineKey;
+    int32_t lineCoefficients[COEFFICIENT_CACHE_MAX];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        int count = parseLine(line, &lineKey, lineCoefficients);
+        if (count >= 0 && (size_t)count <= maxCoefficients && keysEqual(&lineKey, key))
+        {
+            memcpy(coefficients, lineCoefficients, (size_t)count * sizeof(int32_t));
+            result = count;
+        }
+    }
+    fclose(file);
+
+    if (result >= 0)
+    {
+        memoryStore(key, coefficients, (size_t)result);
+    }
+    return result;
+}
+
+int coefficientCacheStore(const char *path, const CoefficientKey *key, const int32_t *coefficients, size_t numCoefficients)
+{
+    if (numCoefficients > COEFFICIENT_CACHE_MAX)
+    {
+        return -1;
+    }
+    memoryStore(key, coefficients, numCoefficients);
+    if (path == NULL)
+    {
+        return 0;
+    }
+
+    char line[MAX_LINE_SIZE];
+    int length = snprintf(line, sizeof(line), "bwcoef %.17g %.17g %u Q%u.%u %zu", key->sampleRate, key->cutoffFrequency,
+                          key->order, key->integerBits, key->fractionalBits, numCoefficients);
+    for (size_t i = 0; i < numCoefficients && length > 0 && (size_t)length < sizeof(line); i++)
+    {
+        length += snprintf(line + length, sizeof(line) - (size_t)length, " %ld", (long)coefficients[i]);
+    }
+    if (length <= 0 || (size_t)length >= sizeof(line) - 1)
+    {
+        return -1;
+    }
+    line[length++] = '\n';
+
+    // (NOTE: 2)
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ssize_t written;
+    do
+    {
+        written = write(fd, line, (size_t)length);
+    } while (written < 0 && errno == EINTR);
+    int status = written == length ? 0 : -1;
+    if (close(fd) < 0)
+    {
+        status = -1;
+    }
+    return status;
+}
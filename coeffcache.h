@@ -0,0 +1,36 @@
+#ifndef _COEFFCACHE_H_
+#define _COEFFCACHE_H_
+
+/**
+ * @file coeffcache.h
+ * @brief Cache of fixed point filter coefficients keyed by the filter design
+ * @details Designing a filter needs tan() and 64 bit fixed point divisions, which are slow without a floating point
+ *          unit. Designed coefficients are kept in memory for the life of the process and can be shared between runs
+ *          through a cache file, so a fleet of short runs with the same settings designs each filter only once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COEFFICIENT_CACHE_MAX 64 // Most coefficients stored for one design
+
+// Everything the coefficients depend on
+typedef struct CoefficientKey
+{
+    double sampleRate;       // Hertz
+    double cutoffFrequency;  // Hertz
+    unsigned order;          // Filter order
+    unsigned integerBits;    // Q format of the coefficients, integer part
+    unsigned fractionalBits; // Q format of the coefficients, fractional part
+} CoefficientKey;
+
+// Look up the coefficients of a design, first in memory and then in the cache file at path (NULL for none).
+// Returns the number of coefficients copied to coefficients, or -1 if the design is not cached or needs more than
+// maxCoefficients.
+int coefficientCacheLoad(const char *path, const CoefficientKey *key, int32_t *coefficients, size_t maxCoefficients);
+
+// Remember the coefficients of a design in memory and append them to the cache file at path (NULL for none).
+// Returns 0 on success, -1 if the cache file could not be written.
+int coefficientCacheStore(const char *path, const CoefficientKey *key, const int32_t *coefficients, size_t numCoefficients);
+
+#endif // _COEFFCACHE_H_
@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+/*
+(NOTE: 1):  cpuid only reports what the CPU implements. The vector registers are usable once the OS saves them on a
+            context switch, which it enables in XCR0: bits 1 and 2 for the 128 and 256 bit halves, bits 5 to 7 for the
+            mask registers and the upper 512 bit state. XCR0 is read with xgetbv, which cpuid leaf 1 reports as OSXSAVE.
+*/
+
+#define XCR0_AVX 0x06    // SSE and AVX state
+#define XCR0_AVX512 0xE6 // SSE, AVX, opmask, ZMM_Hi256 and Hi16_ZMM state
+
+static unsigned detectedFeatures = 0;
+static unsigned allowedFeatures = ~0u;
+static pthread_once_t detectOnce = PTHREAD_ONCE_INIT;
+
+static void cpuFeaturesDetect(void)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    unsigned eax, ebx, ecx, edx;
+    detectedFeatures = CPU_FEATURE_X86_64;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+    {
+        return;
+    }
+
+    // (NOTE: 1)
+    uint32_t xcr0Low, xcr0High;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    if ((xcr0Low & XCR0_AVX) != XCR0_AVX || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        return;
+    }
+    if (ebx & bit_AVX2)
+    {
+        detectedFeatures |= CPU_FEATURE_AVX2;
+    }
+    if ((ebx & bit_AVX2) && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW) && (xcr0Low & XCR0_AVX512) == XCR0_AVX512)
+    {
+        detectedFeatures |= CPU_FEATURE_AVX512;
+    }
+#endif
+}
+
+unsigned cpuFeatures(void)
+{
+    pthread_once(&detectOnce, cpuFeaturesDetect);
+    return detectedFeatures & allowedFeatures;
+}
+
+void cpuFeaturesRestrict(unsigned allowed)
+{
+    allowedFeatures = allowed;
+}
+
+int cpuFeaturesFromName(const char *name, unsigned *features)
+{
+    if (strcmp(name, "portable") == 0)
+    {
+        *features = 0;
+    }
+    else if (strcmp(name, "x86-64") == 0)
+    {
+        *features = CPU_FEATURE_X86_64;
+    }
+    else if (strcmp(name, "avx2") == 0)
+    {
+        *features = CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2;
+    }
+    else if (strcmp(name, "avx512") == 0)
+    {
+        *features = CPU_FEATURE_X86_64 | CPU_FEATURE_AVX2 | CPU_FEATURE_AVX512;
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
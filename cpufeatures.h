@@ -0,0 +1,25 @@
+#ifndef _CPUFEATURES_H_
+#define _CPUFEATURES_H_
+
+/**
+ * @file cpufeatures.h
+ * @brief Instruction set extensions of the host CPU, detected once at startup with cpuid
+ * @details The filter kernels for each extension are compiled into every binary and chosen at run time from these
+ *          flags, so one binary built for the x86-64 baseline uses AVX2 or AVX-512 where the host has them.
+ */
+
+#define CPU_FEATURE_X86_64 (1u << 0) // The hand scheduled x86-64 kernel, always present on x86-64
+#define CPU_FEATURE_AVX2 (1u << 1)   // AVX2, with the OS saving the 256 bit registers
+#define CPU_FEATURE_AVX512 (1u << 2) // AVX-512 F and BW, with the OS saving the 512 bit and mask registers
+
+// Features of the host CPU that may be used, 0 on other architectures. Detected on the first call, thread safe.
+unsigned cpuFeatures(void);
+
+// Use at most the given features, e.g. to compare a kernel with the portable C one. Call before any filtering starts.
+void cpuFeaturesRestrict(unsigned allowed);
+
+// Parse the name of a feature level, portable, x86-64, avx2 or avx512, into the features it allows.
+// Returns 0 on success, -1 if the name is unknown.
+int cpuFeaturesFromName(const char *name, unsigned *features);
+
+#endif // _CPUFEATURES_H_
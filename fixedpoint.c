@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "fixedpoint.h"
+
+// Non-inline functions of fixedpoint.h, (NOTE: 6) there
+
+char *fixedpoint_str(fixedpoint_t a)
+{
+    static char str[32]; // Arbitrarily chosen string size
+
+    int count = 0;
+    int str_pos = 0;
+    char tmp[12] = {0};
+    ulong_fixedpoint_t fractional;
+    ulong_fixedpoint_t integer;
+
+    const ulong_fixedpoint_t one = (ulong_fixedpoint_t)1 << BIT_WIDTH;
+    const ulong_fixedpoint_t mask = one - 1;
+
+    // First place the negative sign if needed and negate the number
+    if (a < 0)
+    {
+        str[str_pos++] = '-';
+        a *= -1;
+    }
+
+    // Calculate the base 10 integer representation
+    integer = fixedpoint_to_int(a);
+    do
+    {
+        tmp[count++] = '0' + integer % 10; // last digit of integer part added to the value of char '0' to get the ascii value of the digit
+        integer /= 10;                     // divide the decimal number by 10 to remove the last digit
+    } while (integer != 0);                // repeat until the integer part is 0
+
+    // Place the integer part in the string
+    while (count > 0)
+    {
+        str[str_pos++] = tmp[--count];
+    }
+
+    // Place the decimal point
+    str[str_pos++] = '.';
+
+    // Shift the fractional part into the integer part
+    fractional = (fixedpoint_fractional_part(a) << INTEGER_BITS) & mask;
+    do
+    {
+        fractional = (fractional & mask) * 10;                 // multiply the fractional part by 10 to get the next digit
+        str[str_pos++] = '0' + (fractional >> BIT_WIDTH) % 10; // ones digit of the fractional part added to the value of char '0' to get the ascii value of the digit
+        count++;
+    } while (fractional != 0 && count < STRING_DECIMALS); // repeat until the fractional part is 0 or the desired precision is reached
+
+    // Remove trailing 0s
+    if (count > 1 && str[str_pos - 1] == '0')
+        str[str_pos - 1] = '\0';
+    else
+        str[str_pos] = '\0';
+
+    return str;
+}
@@ -22,6 +22,19 @@ TODO: Format description Q17.15 (17 bits for integer part, 15 bits for fractiona
             Resolution: 1 / 2^15 ~= 0.00003
 
 (NOTE: 4):  Addition and subtraction can be done directly with the built in operators
+
+(NOTE: 5):  The functions above are Q17.15 in 32 bits, the format of the filter. FIXEDPOINT_FORMAT defines the same
+            operations for another Q format as a family of static inline functions named after a prefix. Only Q1.15 in
+            int16_t is defined, as q1_15_*, for the int16 kernel. The wide type holds a product of two values, twice
+            the storage width. C99 has no _Generic, so the format is chosen by the prefix rather than the argument
+            type. mul truncates like fixedpoint_mul, mul_round rounds half up, which for Q1.15 is exactly the x86
+            pmulhrsw instruction, and the _sat operations clamp to the storage range.
+
+(NOTE: 6):  Everything in this header has internal linkage (static inline functions, static const constants), so any
+            number of translation units can include it and each one can inline the arithmetic into its own loops
+            without link time optimization. Functions too large to be worth inlining, only fixedpoint_str so far, are
+            declared here and defined once in fixedpoint.c, which only has to be linked by programs that call them.
+            An unused static inline function costs nothing and raises no warning.
 */
 
 #define BIT_WIDTH 32                               // (NOTE: 1)
@@ -65,87 +78,88 @@ typedef uint64_t ulong_fixedpoint_t;
 #define fixedpoint_fractional_part(Val) (Val & ((1 << FRACTIONAL_BITS) - 1)) // Get fractional part
 
 /*
-    Define commonly used functions
+    Define commonly used functions, (NOTE: 6)
 */
-fixedpoint_t fixedpoint_add(fixedpoint_t a, fixedpoint_t b)
+static inline fixedpoint_t fixedpoint_add(fixedpoint_t a, fixedpoint_t b)
 {
     // (NOTE: 4)
     return a + b;
 }
 
-fixedpoint_t fixedpoint_sub(fixedpoint_t a, fixedpoint_t b)
+static inline fixedpoint_t fixedpoint_sub(fixedpoint_t a, fixedpoint_t b)
 {
     // (NOTE: 4)
     return a - b;
 }
 
-fixedpoint_t fixedpoint_mul(fixedpoint_t a, fixedpoint_t b)
+static inline fixedpoint_t fixedpoint_mul(fixedpoint_t a, fixedpoint_t b)
 {
     // First cast up to long to avoid overflow, then shift out the added fractional bits
     return (fixedpoint_t)(((long_fixedpoint_t)a * (long_fixedpoint_t)b) >> FRACTIONAL_BITS);
 }
 
-fixedpoint_t fixedpoint_div(fixedpoint_t a, fixedpoint_t b)
+static inline fixedpoint_t fixedpoint_div(fixedpoint_t a, fixedpoint_t b)
 {
     // First cast up to long to avoid overflow
     return (((long_fixedpoint_t)a << FRACTIONAL_BITS) / (long_fixedpoint_t)b);
 }
 
 /*
-    Define printing functions
+    Define printing functions, compiled in fixedpoint.c
 */
-char *fixedpoint_str(fixedpoint_t a)
-{
-    static char str[32]; // Arbitrarily chosen string size
-
-    int count = 0;
-    int str_pos = 0;
-    char tmp[12] = {0};
-    ulong_fixedpoint_t fractional;
-    ulong_fixedpoint_t integer;
-
-    const ulong_fixedpoint_t one = (ulong_fixedpoint_t)1 << BIT_WIDTH;
-    const ulong_fixedpoint_t mask = one - 1;
-
-    // First place the negative sign if needed and negate the number
-    if (a < 0)
-    {
-        str[str_pos++] = '-';
-        a *= -1;
-    }
+// Decimal representation of a, in a static buffer overwritten by the next call
+char *fixedpoint_str(fixedpoint_t a);
 
-    // Calculate the base 10 integer representation
-    integer = fixedpoint_to_int(a);
-    do
-    {
-        tmp[count++] = '0' + integer % 10; // last digit of integer part added to the value of char '0' to get the ascii value of the digit
-        integer /= 10;                     // divide the decimal number by 10 to remove the last digit
-    } while (integer != 0);                // repeat until the integer part is 0
-
-    // Place the integer part in the string
-    while (count > 0)
-    {
-        str[str_pos++] = tmp[--count];
+/*
+    Q format generic layer, (NOTE: 5)
+*/
+#define FIXEDPOINT_FORMAT(prefix, storage, wide, integerBits, fractionalBits)                                            \
+    typedef storage prefix##_t;                                                                                          \
+    static const int prefix##_integer_bits = (integerBits);                                                              \
+    static const int prefix##_fractional_bits = (fractionalBits);                                                        \
+    static const wide prefix##_max = ((wide)1 << ((integerBits) + (fractionalBits)-1)) - 1;                             \
+    static const wide prefix##_min = -((wide)1 << ((integerBits) + (fractionalBits)-1));                                \
+    static inline prefix##_t prefix##_from_real(double value)                                                            \
+    {                                                                                                                    \
+        return (prefix##_t)(value * (double)((wide)1 << (fractionalBits)) + (value >= 0 ? 0.5 : -0.5));                 \
+    }                                                                                                                    \
+    static inline double prefix##_to_real(prefix##_t value)                                                              \
+    {                                                                                                                    \
+        return (double)value / (double)((wide)1 << (fractionalBits));                                                    \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_from_int(storage value)                                                            \
+    {                                                                                                                    \
+        return (prefix##_t)((wide)value << (fractionalBits));                                                            \
+    }                                                                                                                    \
+    static inline storage prefix##_to_int(prefix##_t value)                                                              \
+    {                                                                                                                    \
+        return (storage)(value >> (fractionalBits));                                                                     \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_saturate(wide value)                                                               \
+    {                                                                                                                    \
+        return (prefix##_t)(value > prefix##_max ? prefix##_max : value < prefix##_min ? prefix##_min : value);          \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_add_sat(prefix##_t a, prefix##_t b)                                                \
+    {                                                                                                                    \
+        return prefix##_saturate((wide)a + b);                                                                           \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_sub_sat(prefix##_t a, prefix##_t b)                                               \
+    {                                                                                                                    \
+        return prefix##_saturate((wide)a - b);                                                                           \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_mul(prefix##_t a, prefix##_t b)                                                    \
+    {                                                                                                                    \
+        return (prefix##_t)(((wide)a * b) >> (fractionalBits));                                                          \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_mul_round(prefix##_t a, prefix##_t b)                                              \
+    {                                                                                                                    \
+        return (prefix##_t)(((wide)a * b + ((wide)1 << ((fractionalBits)-1))) >> (fractionalBits));                     \
+    }                                                                                                                    \
+    static inline prefix##_t prefix##_div(prefix##_t a, prefix##_t b)                                                    \
+    {                                                                                                                    \
+        return (prefix##_t)(((wide)a << (fractionalBits)) / b);                                                          \
     }
 
-    // Place the decimal point
-    str[str_pos++] = '.';
-
-    // Shift the fractional part into the integer part
-    fractional = (fixedpoint_fractional_part(a) << INTEGER_BITS) & mask;
-    do
-    {
-        fractional = (fractional & mask) * 10;                 // multiply the fractional part by 10 to get the next digit
-        str[str_pos++] = '0' + (fractional >> BIT_WIDTH) % 10; // ones digit of the fractional part added to the value of char '0' to get the ascii value of the digit
-        count++;
-    } while (fractional != 0 && count < STRING_DECIMALS); // repeat until the fractional part is 0 or the desired precision is reached
-
-    // Remove trailing 0s
-    if (count > 1 && str[str_pos - 1] == '0')
-        str[str_pos - 1] = '\0';
-    else
-        str[str_pos] = '\0';
-
-    return str;
-}
+FIXEDPOINT_FORMAT(q1_15, int16_t, int32_t, 1, 15) // Audio samples, one sign bit and 15 fractional bits, for --kernel int16
+
 #endif // FIXEDPOINT_H
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef _LIBBUTTERWORTH_H_
+#define _LIBBUTTERWORTH_H_
+
+/**
+ * @file libbutterworth.h
+ * @brief Block processing API of the fixed point Butterworth low-pass filter, built by make lib
+ * @details Embeds the filter of the butterworth tool in another program without going through files. A handle filters
+ *          one channel of unsigned 16 bit samples (0 to 65535) and keeps its state between blocks, so a stream can be
+ *          fed in blocks of any size and the output is the same as that of the tool run on the whole stream with
+ *          -i u16 -o u16. Kernels are chosen for the CPU at run time like in the tool. Handles are independent, one
+ *          handle must not be used by two threads at the same time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define BUTTERWORTH_API __attribute__((visibility("default")))
+#else
+#define BUTTERWORTH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Filter of one channel, opaque to the caller
+typedef struct Butterworth Butterworth;
+
+// Create a filter of the given order (2 to 16) with the cutoff frequency in Hertz for the sampling rate in Hertz.
+// Returns NULL if the design can not be represented in fixed point (see butterworth --help) or out of memory.
+BUTTERWORTH_API Butterworth *butterworthCreate(double samplingRate, double cutoffFrequency, unsigned order);
+
+// Filter numSamples samples from input to output, which may be the same buffer, continuing from the previous block
+BUTTERWORTH_API void butterworthProcessBlock(Butterworth *filter, const uint16_t *input, uint16_t *output, size_t numSamples);
+
+// Filter numSamples Q17.15 fixed point samples in place, the format the filter computes in: a 16 bit sample s enters
+// as s << 15 and butterworthProcessBlock returns y / 2 + 32767 of an output y. Continues from the previous block of
+// either function.
+BUTTERWORTH_API void butterworthProcessFixed(Butterworth *filter, int32_t *samples, size_t numSamples);
+
+// Clear the state, the next block is filtered as the start of a new stream
+BUTTERWORTH_API void butterworthReset(Butterworth *filter);
+
+// Free a filter, NULL is ignored
+BUTTERWORTH_API void butterworthDestroy(Butterworth *filter);
+
+// Many filters of one design, each filtering its own channel, opaque to the caller
+typedef struct ButterworthBank ButterworthBank;
+
+// Create numFilters filters of one design in Transposed Direct Form II, which share the coefficients and keep only two
+// state words (8 bytes) per section each, where a Butterworth handle holds the coefficients and four state words of
+// every section. The output of each filter is the same as that of a handle. Returns NULL like butterworthCreate, or if
+// numFilters is 0.
+BUTTERWORTH_API ButterworthBank *butterworthBankCreate(double samplingRate, double cutoffFrequency, unsigned order, size_t numFilters);
+
+// Filter numSamples samples of filter number filter (below numFilters) like butterworthProcessBlock
+BUTTERWORTH_API void butterworthBankProcessBlock(ButterworthBank *bank, size_t filter, const uint16_t *input, uint16_t *output,
+                                                 size_t numSamples);
+
+// Clear the state of every filter of the bank
+BUTTERWORTH_API void butterworthBankReset(ButterworthBank *bank);
+
+// Free a bank, NULL is ignored
+BUTTERWORTH_API void butterworthBankDestroy(ButterworthBank *bank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _LIBBUTTERWORTH_H_
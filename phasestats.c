@@ -0,0 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <sys/resource.h>
+
+#include "phasestats.h"
+
+static const char *const phaseNames[STATS_PHASES] = {"init", "read", "parse", "filter", "format", "write"};
+
+// High water mark of the resident set of the process in kilobytes, (NOTE: 2)
+static long peakRss(void)
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+void statsBegin(PhaseStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->start = statsNow();
+}
+
+void statsAdd(PhaseStats *stats, StatsPhase phase, uint64_t nanoseconds, uint64_t bytes)
+{
+    long rss = peakRss();
+    stats->nanoseconds[phase] += nanoseconds;
+    stats->bytes[phase] += bytes;
+    if (rss > stats->peakRss[phase])
+    {
+        stats->peakRss[phase] = rss;
+    }
+}
+
+void statsMerge(PhaseStats *stats, const PhaseStats *other)
+{
+    for (unsigned phase = 0; phase < STATS_PHASES; phase++)
+    {
+        stats->nanoseconds[phase] += other->nanoseconds[phase];
+        stats->bytes[phase] += other->bytes[phase];
+        if (other->peakRss[phase] > stats->peakRss[phase])
+        {
+            stats->peakRss[phase] = other->peakRss[phase];
+        }
+    }
+}
+
+// Print a rate with three decimals, or null if it has no meaning (no samples, bytes or time)
+static void printRate(FILE *file, const char *name, double numerator, double denominator)
+{
+    if (numerator > 0.0 && denominator > 0.0)
+    {
+        fprintf(file, "\"%s\": %.3f", name, numerator / denominator);
+    }
+    else
+    {
+        fprintf(file, "\"%s\": null", name);
+    }
+}
+
+int statsPrint(const PhaseStats *stats, FILE *file, uint64_t numSamples, unsigned channels)
+{
+    uint64_t total = statsNow() - stats->start;
+    fprintf(file, "{\"samples\": %llu, \"channels\": %u, \"total_ns\": %llu, ", (unsigned long long)numSamples, channels,
+            (unsigned long long)total);
+    printRate(file, "ns_per_sample", (double)total, (double)numSamples);
+    fprintf(file, ", \"peak_rss_kb\": %ld, \"phases\": {\n", peakRss());
+    for (unsigned phase = 0; phase < STATS_PHASES; phase++)
+    {
+        fprintf(file, "  \"%s\": {\"ns\": %llu, ", phaseNames[phase], (unsigned long long)stats->nanoseconds[phase]);
+        printRate(file, "ns_per_sample", (double)stats->nanoseconds[phase], (double)numSamples);
+        fprintf(file, ", \"bytes\": %llu, ", (unsigned long long)stats->bytes[phase]);
+        // Bytes per nanosecond times 1000 is MB (10^6 bytes) per second
+        printRate(file, "mb_per_s", (double)stats->bytes[phase] * 1000.0, (double)stats->nanoseconds[phase]);
+        fprintf(file, ", \"peak_rss_kb\": %ld}%s\n", stats->peakRss[phase], phase + 1 < STATS_PHASES ? "," : "");
+    }
+    fprintf(file, "}}\n");
+    return fflush(file) == 0 && !ferror(file) ? 0 : -1;
+}
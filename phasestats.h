@@ -0,0 +1,73 @@
+#ifndef _PHASESTATS_H_
+#define _PHASESTATS_H_
+
+/**
+ * @file phasestats.h
+ * @brief Time, throughput and peak memory of each phase of a run, reported as JSON by --stats
+ * @details The phases are timed a block at a time, not a sample at a time, so the timestamps cost nothing next to
+ *          the work they measure. Without --stats no timestamp is taken at all, the only cost is a branch per block
+ *          and per read() or write().
+ */
+
+/*
+(NOTE: 1):  Timestamps come from CLOCK_MONOTONIC. On x86-64 Linux it is read from the TSC in the vDSO, without a system
+            call, so a timestamp costs about as much as rdtsc itself but is already in nanoseconds, is the same on
+            every core and does not jump with the wall clock.
+
+(NOTE: 2):  Peak RSS is the high water mark of the whole process (getrusage), sampled whenever a phase ends. A phase's
+            peak is the largest value seen at its ends, so it is the memory the process had touched by the time that
+            phase last ran, not memory owned by the phase.
+
+(NOTE: 3):  On the paths that run phases on several threads at once (--pipeline, --io uring, --batch) each phase is the
+            time its threads spent working on it, without the time they waited on each other. The phases then overlap
+            and can add up to more than the total time of the run; a phase close to the total is the one the others
+            wait for.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Phases of a run, in the order they first happen
+typedef enum StatsPhase
+{
+    STATS_PHASE_INIT,   // Designing the filter and setting up the buffers
+    STATS_PHASE_READ,   // Opening the input and read()
+    STATS_PHASE_PARSE,  // Converting the bytes read to samples
+    STATS_PHASE_FILTER, // The filter kernels
+    STATS_PHASE_FORMAT, // Converting the samples to output bytes
+    STATS_PHASE_WRITE,  // Opening the output, write() and closing it
+    STATS_PHASES
+} StatsPhase;
+
+// Totals of every phase of a run
+typedef struct PhaseStats
+{
+    uint64_t start;                     // Timestamp of statsBegin, in nanoseconds
+    uint64_t nanoseconds[STATS_PHASES]; // Time spent in each phase
+    uint64_t bytes[STATS_PHASES];       // Bytes each phase went through, 0 for none
+    long peakRss[STATS_PHASES];         // Kilobytes, (NOTE: 2)
+} PhaseStats;
+
+// Monotonic timestamp in nanoseconds, (NOTE: 1)
+static inline uint64_t statsNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Clear the totals and start the clock of the whole run
+void statsBegin(PhaseStats *stats);
+
+// Add the time and bytes of one run of a phase that has just ended
+void statsAdd(PhaseStats *stats, StatsPhase phase, uint64_t nanoseconds, uint64_t bytes);
+
+// Add the totals of one thread's phases to another's, (NOTE: 3)
+void statsMerge(PhaseStats *stats, const PhaseStats *other);
+
+// Write the totals as a JSON object: samples, channels, total time, and per phase ns, ns/sample, MB/s and peak RSS.
+// Returns 0 on success, -1 if the file could not be written.
+int statsPrint(const PhaseStats *stats, FILE *file, uint64_t numSamples, unsigned channels);
+
+#endif // _PHASESTATS_H_
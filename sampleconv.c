@@ -0,0 +1,132 @@
+/*
+    Convert sample files between the text (.dat) format, raw 16 bit PCM and WAV.
+    Uses the same reader and writer as the filter, so any file one accepts the other does too.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sampleio.h"
+
+#define BLOCK_SIZE (64 * 1024)
+#define DEFAULT_SAMPLE_RATE 22000 // Written to WAV files converted from formats without a sample rate
+
+int main(int argc, char *argv[])
+{
+    SampleFormat inputFormat = SAMPLE_FORMAT_AUTO;
+    SampleFormat outputFormat = SAMPLE_FORMAT_U16;
+    int outputHeader = 1;
+    unsigned sampleRate = DEFAULT_SAMPLE_RATE;
+    unsigned outputBits = 0;
+    const char *inputPath = NULL;
+    const char *outputPath = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--input-format") == 0) && i + 1 < argc)
+        {
+            if (sampleFormatFromName(argv[++i], &inputFormat) < 0)
+            {
+                fprintf(stderr, "Unknown input format: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output-format") == 0) && i + 1 < argc)
+        {
+            if (sampleFormatFromName(argv[++i], &outputFormat) < 0 || outputFormat == SAMPLE_FORMAT_AUTO)
+            {
+                fprintf(stderr, "Unknown output format: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--no-header") == 0)
+        {
+            outputHeader = 0;
+        }
+        else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc)
+        {
+            sampleRate = (unsigned)atoi(argv[++i]);
+            if (sampleRate == 0)
+            {
+                fprintf(stderr, "Invalid sample rate: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc)
+        {
+            outputBits = (unsigned)atoi(argv[++i]);
+            if (outputBits != 16 && outputBits != 24 && outputBits != 32)
+            {
+                fprintf(stderr, "Invalid sample width: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (inputPath == NULL)
+        {
+            inputPath = argv[i];
+        }
+        else if (outputPath == NULL)
+        {
+            outputPath = argv[i];
+        }
+    }
+
+    if (inputPath == NULL || outputPath == NULL)
+    {
+        fprintf(stderr, "Usage: %s [options] <input_file> <output_file>\n", argv[0]);
+        fprintf(stderr, "  -i, --input-format <format>  auto, text, u16, s16 or wav (default: auto)\n");
+        fprintf(stderr, "  -o, --output-format <format> text, u16, s16 or wav (default: u16)\n");
+        fprintf(stderr, "      --no-header              Write binary output as raw PCM without a header\n");
+        fprintf(stderr, "      --sample-rate <hz>       Rate written to WAV output when the input has none (default: %d)\n", DEFAULT_SAMPLE_RATE);
+        fprintf(stderr, "      --bits <16|24|32>        Sample width of WAV output (default: that of a WAV input, otherwise 16)\n");
+        return 1;
+    }
+
+    SampleReader inputFile;
+    int inputStatus = sampleReaderOpen(&inputFile, inputPath, BLOCK_SIZE, inputFormat);
+    SampleLayout layout = inputFile.layout;
+    layout.sampleRate = layout.sampleRate == 0 ? sampleRate : layout.sampleRate;
+    layout.bitsPerSample = outputBits == 0 ? layout.bitsPerSample : outputBits;
+    SampleWriter outputFile;
+    int outputStatus = inputStatus < 0 ? -1 : sampleWriterOpen(&outputFile, outputPath, BLOCK_SIZE, outputFormat, outputHeader, &layout);
+
+    if (inputStatus < 0 || outputStatus < 0)
+    {
+        fprintf(stderr, "Failed to open input or output file\n");
+        return 1;
+    }
+
+    static uint16_t samples[BLOCK_SIZE / sizeof(uint16_t)];
+    long count;
+    while ((count = sampleReaderRead(&inputFile, samples, sizeof(samples) / sizeof(samples[0]))) > 0)
+    {
+        if (sampleWriterWrite(&outputFile, samples, (size_t)count) < 0)
+        {
+            fprintf(stderr, "Error writing output samples\n");
+            return 1;
+        }
+    }
+
+    if (count < 0)
+    {
+        if (inputFile.format == SAMPLE_FORMAT_TEXT)
+        {
+            fprintf(stderr, "Error reading input sample at line %zu\n", inputFile.line);
+        }
+        else
+        {
+            fprintf(stderr, "Error reading input sample %zu\n", inputFile.line);
+        }
+        return 1;
+    }
+
+    sampleReaderClose(&inputFile);
+    if (sampleWriterClose(&outputFile) < 0)
+    {
+        fprintf(stderr, "Error writing output samples\n");
+        return 1;
+    }
+
+    return 0;
+}
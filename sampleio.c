@@ -0,0 +1,1098 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // madvise()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "phasestats.h"
+#include "sampleio.h"
+
+/*
+(NOTE: 1):  Samples are parsed eight bytes at a time (SWAR, SIMD within a register). A sample is at most five digits
+            plus its terminating newline, so one 64 bit load almost always holds a whole sample. Whenever fewer than
+            eight bytes are left in the buffer more data is read first, so the load never runs past the valid data.
+
+(NOTE: 2):  The byte wise digit test: x ^ '0' leaves a value in [0, 9] for the digits. Any other byte has a bit set in
+            the high nibble, or has a low nibble that carries into bit 4 when 6 is added to it.
+
+(NOTE: 3):  Digits are combined pairwise: 8 bit lanes hold two digits, then 16 bit lanes four, then 32 bit lanes eight.
+            The digits are first shifted to the top of the register so missing leading digits become zeros.
+
+(NOTE: 4):  With SSE2/AVX2 a 64 byte window is classified at once into a bit mask of newlines and a bit mask of digits.
+            The position of every sample in the window is then known up front, so the samples are converted
+            independently of each other instead of each one waiting for the length of the previous one.
+
+(NOTE: 5):  Output is formatted two digits at a time from a table of all 100 digit pairs, a sample needs at most three
+            table lookups. Text is collected in a large buffer and handed to the kernel with a single write().
+
+(NOTE: 6):  A WAV file is a RIFF container: "RIFF", the file size, "WAVE", then chunks of a four character id, a size and
+            the (even padded) contents. The "fmt " chunk describes the samples and the "data" chunk holds them. Chunks
+            are walked in order without seeking so WAV can be read from a pipe, anything after the data is ignored.
+*/
+
+#define SWAR_WIDTH 8         // Bytes parsed at once, (NOTE: 1)
+#define MIN_BUFFER_SIZE SAMPLE_MIN_BUFFER_SIZE // Buffers smaller than this are rounded up
+#define MAX_SAMPLE 65535     // Largest value that can be stored in a sample
+#define MAX_SAMPLE_TEXT 6    // Longest formatted sample, five digits and a newline
+#define WAV_HEADER_SIZE 44   // RIFF header, 16 byte "fmt " chunk and "data" chunk header as written
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_UNKNOWN_SIZE 0xFFFFFFFFu // Chunk size written when the length is not known, e.g. to a pipe
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && defined(__GNUC__)
+#define SAMPLEIO_SWAR 1
+#endif
+
+#if defined(SAMPLEIO_SWAR) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#define SAMPLEIO_SIMD 1
+#define SIMD_WINDOW 64 // Bytes classified per window, (NOTE: 4)
+#endif
+
+int sampleFormatFromName(const char *name, SampleFormat *format)
+{
+    static const char *const names[] = {"auto", "text", "u16", "s16", "wav"};
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *format = (SampleFormat)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+SampleFormat sampleHeaderFormat(const unsigned char *bytes, size_t len)
+{
+    if (len >= SAMPLE_HEADER_SIZE && memcmp(bytes, SAMPLE_HEADER_U16, SAMPLE_HEADER_SIZE) == 0)
+    {
+        return SAMPLE_FORMAT_U16;
+    }
+    else if (len >= SAMPLE_HEADER_SIZE && memcmp(bytes, SAMPLE_HEADER_S16, SAMPLE_HEADER_SIZE) == 0)
+    {
+        return SAMPLE_FORMAT_S16;
+    }
+    else if (len >= SAMPLE_PEEK_SIZE && memcmp(bytes, "RIFF", 4) == 0 && memcmp(bytes + 8, "WAVE", 4) == 0)
+    {
+        return SAMPLE_FORMAT_WAV;
+    }
+    return SAMPLE_FORMAT_TEXT;
+}
+
+static uint32_t load32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32(unsigned char *p, uint32_t value)
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+    p[2] = (unsigned char)((value >> 16) & 0xFF);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+// Load a little endian sample from an arbitrarily aligned address
+static uint16_t sampleLoad(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Store a little endian sample to an arbitrarily aligned address
+static void sampleStore(unsigned char *p, uint16_t sample)
+{
+    p[0] = (unsigned char)(sample & 0xFF);
+    p[1] = (unsigned char)(sample >> 8);
+}
+
+static int isSampleSeparator(unsigned char c)
+{
+    return c == '\n' || c == ' ' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static int sampleReaderFill(SampleReader *reader);
+
+// Read until at least n unparsed bytes are buffered. Returns 0 on success, -1 if the file ends first.
+static int sampleReaderRequire(SampleReader *reader, size_t n)
+{
+    while (reader->len - reader->pos < n)
+    {
+        if (reader->eof || sampleReaderFill(reader) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Walk the RIFF chunks up to the start of the samples, (NOTE: 6). Returns 0 on success, -1 if the file is not a
+// supported WAV file.
+static int readWavHeader(SampleReader *reader)
+{
+    if (sampleReaderRequire(reader, SAMPLE_PEEK_SIZE) < 0)
+    {
+        return -1;
+    }
+    reader->pos += SAMPLE_PEEK_SIZE;
+
+    int haveFormat = 0;
+    for (;;)
+    {
+        if (sampleReaderRequire(reader, 8) < 0)
+        {
+            return -1;
+        }
+        const unsigned char *chunk = reader->buffer + reader->pos;
+        uint32_t size = load32(chunk + 4);
+        reader->pos += 8;
+
+        if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                return -1;
+            }
+            reader->dataRemaining = size == WAV_UNKNOWN_SIZE ? SIZE_MAX : size;
+
+            // Samples are read a whole frame at a time, so the buffer has to hold at least one
+            size_t frameBytes = reader->layout.channels * reader->layout.bitsPerSample / 8;
+            if (reader->capacity < frameBytes && !reader->ownsBuffer)
+            {
+                return -1;
+            }
+            else if (reader->capacity < frameBytes)
+            {
+                unsigned char *buffer = (unsigned char *)realloc(reader->buffer, frameBytes);
+                if (buffer == NULL)
+                {
+                    return -1;
+                }
+                reader->buffer = buffer;
+                reader->capacity = frameBytes;
+            }
+            return 0;
+        }
+        else if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            // The buffer is at least MIN_BUFFER_SIZE bytes, enough for the largest format chunk
+            if (size < 16 || size > 40 || sampleReaderRequire(reader, size) < 0)
+            {
+                return -1;
+            }
+            const unsigned char *fmt = reader->buffer + reader->pos;
+            unsigned tag = sampleLoad(fmt);
+            if (tag == WAV_FORMAT_EXTENSIBLE && size >= 40)
+            {
+                tag = sampleLoad(fmt + 24); // First two bytes of the sub format GUID
+            }
+            reader->layout.channels = sampleLoad(fmt + 2);
+            reader->layout.sampleRate = load32(fmt + 4);
+            reader->layout.bitsPerSample = sampleLoad(fmt + 14);
+            unsigned blockAlign = sampleLoad(fmt + 12);
+            if (tag != WAV_FORMAT_PCM || reader->layout.channels == 0 || reader->layout.channels > SAMPLE_MAX_CHANNELS ||
+                (reader->layout.bitsPerSample != 16 && reader->layout.bitsPerSample != 24 && reader->layout.bitsPerSample != 32) ||
+                blockAlign != reader->layout.channels * reader->layout.bitsPerSample / 8)
+            {
+                return -1;
+            }
+            haveFormat = 1;
+        }
+
+        // Skip the rest of the chunk, which may be larger than the buffer
+        size_t skip = (size_t)size + (size & 1);
+        while (skip > 0)
+        {
+            size_t n = reader->len - reader->pos < skip ? reader->len - reader->pos : skip;
+            reader->pos += n;
+            skip -= n;
+            if (skip > 0 && sampleReaderRequire(reader, 1) < 0)
+            {
+                return -1;
+            }
+        }
+    }
+}
+
+static int readerOpen(SampleReader *reader, const char *path, unsigned char *buffer, size_t bufferSize, int ownsBuffer, SampleFormat format)
+{
+    reader->capacity = bufferSize;
+    reader->buffer = buffer;
+    reader->ownsBuffer = ownsBuffer;
+    reader->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    reader->pos = 0;
+    reader->len = 0;
+    reader->eof = 0;
+    reader->line = 1;
+    reader->lineHasSample = 0;
+    reader->format = format;
+    reader->layout.channels = 1;
+    reader->layout.sampleRate = 0;
+    reader->layout.bitsPerSample = 16;
+    reader->dataRemaining = SIZE_MAX;
+    reader->bytesRead = 0;
+    reader->timed = 0;
+    reader->readNanoseconds = 0;
+
+    if (reader->buffer == NULL || reader->fd < 0)
+    {
+        sampleReaderClose(reader);
+        return -1;
+    }
+
+    // Look for a header, text files never start with one. Not needed for text, which saves waiting on a slow pipe.
+    while (format != SAMPLE_FORMAT_TEXT && reader->len < SAMPLE_PEEK_SIZE && !reader->eof)
+    {
+        if (sampleReaderFill(reader) < 0)
+        {
+            sampleReaderClose(reader);
+            return -1;
+        }
+    }
+
+    SampleFormat headerFormat = sampleHeaderFormat(reader->buffer, reader->len);
+
+    if (format == SAMPLE_FORMAT_AUTO)
+    {
+        reader->format = headerFormat;
+    }
+    else if ((headerFormat != SAMPLE_FORMAT_TEXT && headerFormat != format) || (format == SAMPLE_FORMAT_WAV && headerFormat != format))
+    {
+        // The header disagrees with the requested format, WAV can not be read without its header
+        sampleReaderClose(reader);
+        return -1;
+    }
+
+    if (headerFormat == SAMPLE_FORMAT_WAV && readWavHeader(reader) < 0)
+    {
+        sampleReaderClose(reader);
+        return -1;
+    }
+    else if (headerFormat == SAMPLE_FORMAT_U16 || headerFormat == SAMPLE_FORMAT_S16)
+    {
+        reader->pos = SAMPLE_HEADER_SIZE;
+    }
+    return 0;
+}
+
+int sampleReaderOpen(SampleReader *reader, const char *path, size_t bufferSize, SampleFormat format)
+{
+    size_t capacity = bufferSize < MIN_BUFFER_SIZE ? MIN_BUFFER_SIZE : bufferSize;
+    return readerOpen(reader, path, (unsigned char *)malloc(capacity), capacity, 1, format);
+}
+
+int sampleReaderOpenBuffer(SampleReader *reader, const char *path, unsigned char *buffer, size_t bufferSize, SampleFormat format)
+{
+    return readerOpen(reader, path, bufferSize < MIN_BUFFER_SIZE ? NULL : buffer, bufferSize, 0, format);
+}
+
+// Move any unparsed bytes to the front of the buffer and read more data after them
+static int sampleReaderFill(SampleReader *reader)
+{
+    size_t remaining = reader->len - reader->pos;
+    memmove(reader->buffer, reader->buffer + reader->pos, remaining);
+    reader->pos = 0;
+    reader->len = remaining;
+
+    for (;;)
+    {
+        uint64_t start = reader->timed ? statsNow() : 0;
+        ssize_t result = read(reader->fd, reader->buffer + reader->len, reader->capacity - reader->len);
+        if (reader->timed)
+        {
+            reader->readNanoseconds += statsNow() - start;
+        }
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result < 0)
+        {
+            return -1;
+        }
+        else if (result == 0)
+        {
+            reader->eof = 1;
+        }
+        reader->len += (size_t)result;
+        reader->bytesRead += (uint64_t)result;
+        return 0;
+    }
+}
+
+// Parse one sample one character at a time. Used near the end of the buffer and for unusual input (leading zeros).
+// Returns 1 if a sample was parsed, 0 if more data must be read first, -1 if the sample is malformed.
+static int parseSampleScalar(SampleReader *reader, uint16_t *sample)
+{
+    const unsigned char *start = reader->buffer + reader->pos;
+    const unsigned char *end = reader->buffer + reader->len;
+    const unsigned char *p = start;
+    uint32_t value = 0;
+
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (uint32_t)(*p++ - '0');
+        if (value > MAX_SAMPLE)
+        {
+            return -1;
+        }
+    }
+
+    if (p == end && !reader->eof)
+    {
+        // The sample continues past the data read so far, unless it already fills the whole buffer
+        return (reader->len - reader->pos == reader->capacity) ? -1 : 0;
+    }
+    if (p == start || (p < end && !isSampleSeparator(*p)))
+    {
+        return -1;
+    }
+
+    *sample = (uint16_t)value;
+    reader->pos += (size_t)(p - start);
+    return 1;
+}
+
+#ifdef SAMPLEIO_SWAR
+// Parse one sample from the next eight bytes of the buffer, (NOTE: 1)
+// Returns 1 if a sample was parsed, 0 if the scalar parser has to handle it, -1 if the sample is malformed.
+static int parseSampleSwar(SampleReader *reader, uint16_t *sample)
+{
+    uint64_t chunk;
+    memcpy(&chunk, reader->buffer + reader->pos, sizeof(chunk));
+
+    // Find the first byte that is not a digit, (NOTE: 2)
+    uint64_t digits = chunk ^ 0x3030303030303030ULL;
+    uint64_t nonDigit = (digits & 0xF0F0F0F0F0F0F0F0ULL) | (((digits & 0x0F0F0F0F0F0F0F0FULL) + 0x0606060606060606ULL) & 0x1010101010101010ULL);
+    if (nonDigit == 0)
+    {
+        return 0;
+    }
+    unsigned length = (unsigned)__builtin_ctzll(nonDigit) / 8;
+    if (length == 0 || !isSampleSeparator(reader->buffer[reader->pos + length]))
+    {
+        return -1;
+    }
+
+    // Combine the digits into a single value, (NOTE: 3)
+    uint64_t value = digits << (8 * (SWAR_WIDTH - length));
+    value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFULL;
+    value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFULL;
+    value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFFULL;
+    if (value > MAX_SAMPLE)
+    {
+        return -1;
+    }
+
+    *sample = (uint16_t)value;
+    reader->pos += length;
+    return 1;
+}
+
+// Parse consecutive "<digits>\n" lines while a full SWAR load is available.
+// Stops without consuming anything at the first line that does not fit that pattern, which is then handled by the
+// general path. Returns the number of samples parsed.
+static size_t parseLinesSwar(SampleReader *reader, uint16_t *samples, size_t maxSamples)
+{
+    const unsigned char *p = reader->buffer + reader->pos;
+    const unsigned char *limit = reader->buffer + reader->len - SWAR_WIDTH;
+    size_t count = 0;
+
+    while (count < maxSamples && p <= limit)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+
+        uint64_t digits = chunk ^ 0x3030303030303030ULL;
+        uint64_t nonDigit = (digits & 0xF0F0F0F0F0F0F0F0ULL) | (((digits & 0x0F0F0F0F0F0F0F0FULL) + 0x0606060606060606ULL) & 0x1010101010101010ULL);
+        unsigned length = (unsigned)__builtin_ctzll(nonDigit | (1ULL << 63)) / 8;
+        if (length == 0 || length > 5 || p[length] != '\n')
+        {
+            break;
+        }
+
+        uint64_t value = digits << (8 * (SWAR_WIDTH - length));
+        value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFULL;
+        value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFULL;
+        value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFFULL;
+        if (value > MAX_SAMPLE)
+        {
+            break;
+        }
+
+        samples[count++] = (uint16_t)value;
+        p += length + 1;
+    }
+
+    reader->pos = (size_t)(p - reader->buffer);
+    reader->line += count;
+    return count;
+}
+
+#ifdef SAMPLEIO_SIMD
+// Classify a 64 byte window, returning a mask of the newlines and storing a mask of the digits, (NOTE: 4)
+static uint64_t classifyWindow(const unsigned char *p, uint64_t *digitMask)
+{
+    uint64_t newlines = 0;
+    uint64_t digits = 0;
+#ifdef __AVX2__
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i belowZero = _mm256_set1_epi8('0' - 1);
+    const __m256i aboveNine = _mm256_set1_epi8('9' + 1);
+    for (int i = 0; i < SIMD_WINDOW; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, belowZero), _mm256_cmpgt_epi8(aboveNine, bytes));
+        newlines |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)) << i;
+        digits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(isDigit) << i;
+    }
+#else
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    for (int i = 0; i < SIMD_WINDOW; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(bytes, belowZero), _mm_cmplt_epi8(bytes, aboveNine));
+        newlines |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)) << i;
+        digits |= (uint64_t)(uint16_t)_mm_movemask_epi8(isDigit) << i;
+    }
+#endif
+    *digitMask = digits;
+    return newlines;
+}
+
+// Parse every complete "<digits>\n" line of consecutive 64 byte windows.
+// A window is only consumed when all of its lines are well formed, anything else is left for the general path.
+// Returns the number of samples parsed.
+static size_t parseWindowsSimd(SampleReader *reader, uint16_t *samples, size_t maxSamples)
+{
+    const unsigned char *p = reader->buffer + reader->pos;
+    // The last sample of a window may be loaded up to SWAR_WIDTH bytes past the window
+    const unsigned char *end = reader->buffer + reader->len;
+    size_t count = 0;
+
+    // A window holds at most SIMD_WINDOW / 2 lines
+    while (end - p >= SIMD_WINDOW + SWAR_WIDTH && maxSamples - count >= SIMD_WINDOW / 2)
+    {
+        uint64_t digitMask;
+        uint64_t newlines = classifyWindow(p, &digitMask);
+        if (newlines == 0)
+        {
+            break;
+        }
+
+        // Everything up to the last newline has to be a digit or a newline
+        unsigned last = 63 - (unsigned)__builtin_clzll(newlines);
+        uint64_t used = (last == 63) ? ~0ULL : ((1ULL << (last + 1)) - 1);
+        if (((digitMask | newlines) & used) != used)
+        {
+            break;
+        }
+
+        size_t lines = 0;
+        unsigned start = 0;
+        uint64_t invalid = 0;
+        while (newlines != 0)
+        {
+            unsigned stop = (unsigned)__builtin_ctzll(newlines);
+            unsigned length = stop - start;
+            newlines &= newlines - 1;
+
+            uint64_t chunk;
+            memcpy(&chunk, p + start, sizeof(chunk));
+            // The shift is masked so lines of 0 or 8 digits, rejected below, do not shift by 64
+            uint64_t value = (chunk ^ 0x3030303030303030ULL) << ((8 * (SWAR_WIDTH - (length & 7))) & 63);
+            value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FFULL;
+            value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFFULL;
+            value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFFULL;
+
+            // Empty lines, more than five digits and out of range values are rejected together after the loop
+            invalid |= (uint64_t)(length - 1 > 4) | (value > MAX_SAMPLE);
+            samples[count + lines++] = (uint16_t)value;
+            start = stop + 1;
+        }
+        if (invalid)
+        {
+            break;
+        }
+
+        count += lines;
+        p += start;
+    }
+
+    reader->pos = (size_t)(p - reader->buffer);
+    reader->line += count;
+    return count;
+}
+#endif
+#endif
+
+// Copy raw little endian samples out of the buffer. Signed samples are offset into the unsigned range.
+// Wide WAV samples keep their top 16 bits, and samples are copied a whole frame at a time.
+static long readBinary(SampleReader *reader, uint16_t *samples, size_t maxSamples)
+{
+    size_t bytesPerSample = reader->layout.bitsPerSample / 8;
+    size_t frameBytes = reader->layout.channels * bytesPerSample;
+    size_t maxFrames = maxSamples / reader->layout.channels;
+    if (maxFrames == 0)
+    {
+        return -1;
+    }
+
+    size_t count = 0;
+    while (count < maxFrames)
+    {
+        size_t buffered = reader->len - reader->pos;
+        size_t available = (buffered < reader->dataRemaining ? buffered : reader->dataRemaining) / frameBytes;
+        if (available == 0)
+        {
+            if (reader->dataRemaining < frameBytes)
+            {
+                // End of the WAV data chunk, a partial frame at the end is dropped
+                reader->pos += reader->dataRemaining < buffered ? reader->dataRemaining : buffered;
+                reader->dataRemaining = 0;
+                break;
+            }
+            if (reader->eof)
+            {
+                // A trailing odd byte is half a sample
+                if (reader->pos != reader->len)
+                {
+                    return -1;
+                }
+                break;
+            }
+            if (count > 0)
+            {
+                break; // Hand back what has arrived instead of waiting for more input
+            }
+            if (sampleReaderFill(reader) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        size_t n = available < maxFrames - count ? available : maxFrames - count;
+        size_t numSamples = n * reader->layout.channels;
+        const unsigned char *bytes = reader->buffer + reader->pos;
+        uint16_t *out = samples + count * reader->layout.channels;
+        uint16_t offset = sampleFormatOffset(reader->format);
+        if (bytesPerSample == sizeof(uint16_t))
+        {
+            for (size_t i = 0; i < numSamples; i++)
+            {
+                out[i] = sampleLoad(bytes + i * sizeof(uint16_t)) ^ offset;
+            }
+        }
+        else
+        {
+            // The top two bytes of a little endian sample are its last two
+            const unsigned char *top = bytes + bytesPerSample - sizeof(uint16_t);
+            for (size_t i = 0; i < numSamples; i++)
+            {
+                out[i] = sampleLoad(top + i * bytesPerSample) ^ offset;
+            }
+        }
+
+        reader->pos += n * frameBytes;
+        if (reader->dataRemaining != SIZE_MAX)
+        {
+            reader->dataRemaining -= n * frameBytes;
+        }
+        reader->line += numSamples;
+        count += n;
+    }
+    return (long)(count * reader->layout.channels);
+}
+
+static long readText(SampleReader *reader, uint16_t *samples, size_t maxSamples)
+{
+    size_t count = 0;
+    while (count < maxSamples)
+    {
+        if (reader->pos == reader->len)
+        {
+            if (reader->eof || count > 0)
+            {
+                break; // End of file, or hand back what has arrived instead of waiting for more input
+            }
+            if (sampleReaderFill(reader) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        // Skip the separators between samples
+        unsigned char c = reader->buffer[reader->pos];
+        if (c == '\n')
+        {
+            reader->line++;
+            reader->pos++;
+            reader->lineHasSample = 0;
+            continue;
+        }
+        else if (isSampleSeparator(c))
+        {
+            reader->pos++;
+            continue;
+        }
+
+        // One value per line, a second one on the same line is malformed
+        if (reader->lineHasSample)
+        {
+            return -1;
+        }
+
+        int result = 0;
+#ifdef SAMPLEIO_SWAR
+        if (reader->len - reader->pos >= SWAR_WIDTH)
+        {
+            // Hot loops for the common case of one sample per line
+            size_t parsed = 0;
+#ifdef SAMPLEIO_SIMD
+            parsed += parseWindowsSimd(reader, &samples[count], maxSamples - count);
+#endif
+            parsed += parseLinesSwar(reader, &samples[count + parsed], maxSamples - count - parsed);
+            if (parsed > 0)
+            {
+                // The hot loops stop after a newline, before anything unusual, which may be a separator
+                count += parsed;
+                continue;
+            }
+            result = parseSampleSwar(reader, &samples[count]);
+        }
+#endif
+        if (result == 0)
+        {
+            result = parseSampleScalar(reader, &samples[count]);
+        }
+
+        if (result < 0)
+        {
+            return -1;
+        }
+        else if (result == 0)
+        {
+            // The sample is cut off at the end of the buffer
+            if (count > 0)
+            {
+                break;
+            }
+            if (sampleReaderFill(reader) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+        reader->lineHasSample = 1;
+        count++;
+    }
+    return (long)count;
+}
+
+long sampleReaderRead(SampleReader *reader, uint16_t *samples, size_t maxSamples)
+{
+    if (reader->format == SAMPLE_FORMAT_TEXT)
+    {
+        return readText(reader, samples, maxSamples);
+    }
+    return readBinary(reader, samples, maxSamples);
+}
+
+void sampleReaderClose(SampleReader *reader)
+{
+    if (reader->fd > STDERR_FILENO)
+    {
+        close(reader->fd);
+    }
+    if (reader->ownsBuffer)
+    {
+        free(reader->buffer);
+    }
+    reader->fd = -1;
+    reader->buffer = NULL;
+}
+
+// All two digit pairs "00" to "99", (NOTE: 5)
+static const char digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Format a sample followed by a newline, returns the number of characters written
+static size_t formatSample(char *out, uint16_t sample)
+{
+    uint32_t value = sample;
+    char *p = out;
+
+    if (value >= 10000)
+    {
+        uint32_t high = value / 10000; // Single leading digit, a sample is at most 65535
+        uint32_t low = value - high * 10000;
+        *p++ = (char)('0' + high);
+        memcpy(p, &digitPairs[2 * (low / 100)], 2);
+        memcpy(p + 2, &digitPairs[2 * (low % 100)], 2);
+        p += 4;
+    }
+    else if (value >= 100)
+    {
+        uint32_t high = value / 100;
+        if (high >= 10)
+        {
+            memcpy(p, &digitPairs[2 * high], 2);
+            p += 2;
+        }
+        else
+        {
+            *p++ = (char)('0' + high);
+        }
+        memcpy(p, &digitPairs[2 * (value % 100)], 2);
+        p += 2;
+    }
+    else if (value >= 10)
+    {
+        memcpy(p, &digitPairs[2 * value], 2);
+        p += 2;
+    }
+    else
+    {
+        *p++ = (char)('0' + value);
+    }
+
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+// Fill in a canonical 44 byte WAV header for dataBytes bytes of samples, WAV_UNKNOWN_SIZE if the length is not known
+static void formatWavHeader(unsigned char *header, const SampleLayout *layout, uint32_t dataBytes)
+{
+    unsigned blockAlign = layout->channels * layout->bitsPerSample / 8;
+    uint32_t riffSize = dataBytes == WAV_UNKNOWN_SIZE ? WAV_UNKNOWN_SIZE : WAV_HEADER_SIZE - 8 + dataBytes + (dataBytes & 1);
+    memcpy(header, "RIFF", 4);
+    store32(header + 4, riffSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    store32(header + 16, 16);
+    sampleStore(header + 20, WAV_FORMAT_PCM);
+    sampleStore(header + 22, (uint16_t)layout->channels);
+    store32(header + 24, layout->sampleRate);
+    store32(header + 28, layout->sampleRate * blockAlign);
+    sampleStore(header + 32, (uint16_t)blockAlign);
+    sampleStore(header + 34, (uint16_t)layout->bitsPerSample);
+    memcpy(header + 36, "data", 4);
+    store32(header + 40, dataBytes);
+}
+
+static int writerOpen(SampleWriter *writer, const char *path, char *buffer, size_t bufferSize, int ownsBuffer, SampleFormat format,
+                      int header, const SampleLayout *layout)
+{
+    writer->capacity = bufferSize;
+    writer->buffer = buffer;
+    writer->ownsBuffer = ownsBuffer;
+    writer->fd = strcmp(path, "-") == 0 ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer->len = 0;
+    writer->format = format;
+    writer->layout.channels = 1;
+    writer->layout.sampleRate = 0;
+    writer->layout.bitsPerSample = 16;
+    writer->dataBytes = 0;
+    writer->bytesWritten = 0;
+    writer->timed = 0;
+    writer->writeNanoseconds = 0;
+    if (format == SAMPLE_FORMAT_WAV && layout != NULL)
+    {
+        writer->layout = *layout;
+    }
+
+    if (writer->buffer == NULL || writer->fd < 0 || format == SAMPLE_FORMAT_AUTO || writer->layout.channels == 0 ||
+        writer->layout.channels > SAMPLE_MAX_CHANNELS ||
+        (writer->layout.bitsPerSample != 16 && writer->layout.bitsPerSample != 24 && writer->layout.bitsPerSample != 32))
+    {
+        sampleWriterClose(writer);
+        return -1;
+    }
+
+    if (format == SAMPLE_FORMAT_WAV)
+    {
+        // The sizes are patched on close when the output can be seeked
+        formatWavHeader((unsigned char *)writer->buffer, &writer->layout, WAV_UNKNOWN_SIZE);
+        writer->len = WAV_HEADER_SIZE;
+    }
+    else if (header && format != SAMPLE_FORMAT_TEXT)
+    {
+        memcpy(writer->buffer, format == SAMPLE_FORMAT_U16 ? SAMPLE_HEADER_U16 : SAMPLE_HEADER_S16, SAMPLE_HEADER_SIZE);
+        writer->len = SAMPLE_HEADER_SIZE;
+    }
+    return 0;
+}
+
+int sampleWriterOpen(SampleWriter *writer, const char *path, size_t bufferSize, SampleFormat format, int header,
+                     const SampleLayout *layout)
+{
+    size_t capacity = bufferSize < MIN_BUFFER_SIZE ? MIN_BUFFER_SIZE : bufferSize;
+    return writerOpen(writer, path, (char *)malloc(capacity), capacity, 1, format, header, layout);
+}
+
+int sampleWriterOpenBuffer(SampleWriter *writer, const char *path, char *buffer, size_t bufferSize, SampleFormat format,
+                           int header, const SampleLayout *layout)
+{
+    return writerOpen(writer, path, bufferSize < MIN_BUFFER_SIZE ? NULL : buffer, bufferSize, 0, format, header, layout);
+}
+
+int sampleWriterFlush(SampleWriter *writer)
+{
+    size_t written = 0;
+    while (written < writer->len)
+    {
+        uint64_t start = writer->timed ? statsNow() : 0;
+        ssize_t result = write(writer->fd, writer->buffer + written, writer->len - written);
+        if (writer->timed)
+        {
+            writer->writeNanoseconds += statsNow() - start;
+        }
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result < 0)
+        {
+            return -1;
+        }
+        written += (size_t)result;
+    }
+    writer->bytesWritten += written;
+    writer->len = 0;
+    return 0;
+}
+
+// Copy samples into the buffer as raw little endian PCM, wide WAV samples get zeros in their low bytes
+static int writeBinary(SampleWriter *writer, const uint16_t *samples, size_t numSamples)
+{
+    uint16_t offset = sampleFormatOffset(writer->format);
+    size_t bytesPerSample = writer->layout.bitsPerSample / 8;
+    while (numSamples > 0)
+    {
+        size_t space = (writer->capacity - writer->len) / bytesPerSample;
+        if (space == 0)
+        {
+            if (sampleWriterFlush(writer) < 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        size_t n = space < numSamples ? space : numSamples;
+        unsigned char *bytes = (unsigned char *)writer->buffer + writer->len;
+        if (bytesPerSample == sizeof(uint16_t))
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                sampleStore(bytes + i * sizeof(uint16_t), samples[i] ^ offset);
+            }
+        }
+        else
+        {
+            memset(bytes, 0, n * bytesPerSample);
+            unsigned char *top = bytes + bytesPerSample - sizeof(uint16_t);
+            for (size_t i = 0; i < n; i++)
+            {
+                sampleStore(top + i * bytesPerSample, samples[i] ^ offset);
+            }
+        }
+
+        writer->len += n * bytesPerSample;
+        writer->dataBytes += n * bytesPerSample;
+        samples += n;
+        numSamples -= n;
+    }
+    return 0;
+}
+
+int sampleWriterWrite(SampleWriter *writer, const uint16_t *samples, size_t numSamples)
+{
+    if (writer->format != SAMPLE_FORMAT_TEXT)
+    {
+        return writeBinary(writer, samples, numSamples);
+    }
+
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        if (writer->capacity - writer->len < MAX_SAMPLE_TEXT && sampleWriterFlush(writer) < 0)
+        {
+            return -1;
+        }
+        writer->len += formatSample(writer->buffer + writer->len, samples[i]);
+    }
+    return 0;
+}
+
+// Pad the WAV data chunk to an even length and write the final sizes into the header, (NOTE: 6)
+static int finishWav(SampleWriter *writer)
+{
+    if ((writer->dataBytes & 1) != 0)
+    {
+        if (writer->len == writer->capacity && sampleWriterFlush(writer) < 0)
+        {
+            return -1;
+        }
+        writer->buffer[writer->len++] = 0;
+    }
+    if (sampleWriterFlush(writer) < 0)
+    {
+        return -1;
+    }
+
+    // A pipe keeps the unknown sizes, readers take the data to run until the end of the stream
+    if (lseek(writer->fd, 0, SEEK_CUR) < 0)
+    {
+        return 0;
+    }
+    unsigned char header[WAV_HEADER_SIZE];
+    uint32_t dataBytes = writer->dataBytes >= WAV_UNKNOWN_SIZE - WAV_HEADER_SIZE ? WAV_UNKNOWN_SIZE : (uint32_t)writer->dataBytes;
+    formatWavHeader(header, &writer->layout, dataBytes);
+    return pwrite(writer->fd, header, WAV_HEADER_SIZE, 0) == WAV_HEADER_SIZE ? 0 : -1;
+}
+
+int sampleWriterClose(SampleWriter *writer)
+{
+    int status = 0;
+    if (writer->fd >= 0)
+    {
+        status = writer->format == SAMPLE_FORMAT_WAV ? finishWav(writer) : sampleWriterFlush(writer);
+        if (writer->fd > STDERR_FILENO && close(writer->fd) < 0)
+        {
+            status = -1;
+        }
+    }
+    if (writer->ownsBuffer)
+    {
+        free(writer->buffer);
+    }
+    writer->fd = -1;
+    writer->buffer = NULL;
+    return status;
+}
+
+// Hint the kernel that a mapping is walked through once from start to end
+static void adviseSequential(void *base, size_t size)
+{
+    madvise(base, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+}
+
+int sampleMapOpen(SampleMap *map, const char *path, SampleFormat format)
+{
+    struct stat info;
+    map->base = NULL;
+    map->size = 0;
+    map->fd = open(path, O_RDONLY);
+    if (map->fd < 0 || fstat(map->fd, &info) < 0 || !S_ISREG(info.st_mode))
+    {
+        sampleMapClose(map);
+        return -1;
+    }
+
+    map->size = (size_t)info.st_size;
+    if (map->size > 0)
+    {
+        void *base = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+        if (base == MAP_FAILED)
+        {
+            sampleMapClose(map);
+            return -1;
+        }
+        map->base = (unsigned char *)base;
+        adviseSequential(map->base, map->size);
+    }
+
+    // Detect the format from the header, the same way as sampleReaderOpen
+    SampleFormat headerFormat = sampleHeaderFormat(map->base, map->size);
+
+    map->format = format == SAMPLE_FORMAT_AUTO ? headerFormat : format;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    map->format = SAMPLE_FORMAT_TEXT; // Samples would have to be byte swapped, use the reader instead
+#endif
+    if (map->format == SAMPLE_FORMAT_TEXT || map->format == SAMPLE_FORMAT_WAV)
+    {
+        sampleMapClose(map);
+        return 1;
+    }
+
+    size_t headerSize = headerFormat == SAMPLE_FORMAT_TEXT ? 0 : SAMPLE_HEADER_SIZE;
+    if ((headerFormat != SAMPLE_FORMAT_TEXT && headerFormat != map->format) || (map->size - headerSize) % sizeof(uint16_t) != 0)
+    {
+        sampleMapClose(map);
+        return -1;
+    }
+    map->samples = map->base == NULL ? NULL : (uint16_t *)(map->base + headerSize);
+    map->numSamples = (map->size - headerSize) / sizeof(uint16_t);
+    return 0;
+}
+
+int sampleMapCreate(SampleMap *map, const char *path, SampleFormat format, int header, size_t numSamples)
+{
+    size_t headerSize = header ? SAMPLE_HEADER_SIZE : 0;
+    map->base = NULL;
+    map->size = headerSize + numSamples * sizeof(uint16_t);
+    map->format = format;
+    map->numSamples = numSamples;
+    map->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (map->fd < 0 || (format != SAMPLE_FORMAT_U16 && format != SAMPLE_FORMAT_S16) || ftruncate(map->fd, (off_t)map->size) < 0)
+    {
+        sampleMapClose(map);
+        return -1;
+    }
+
+    if (map->size > 0)
+    {
+        void *base = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+        if (base == MAP_FAILED)
+        {
+            sampleMapClose(map);
+            return -1;
+        }
+        map->base = (unsigned char *)base;
+        adviseSequential(map->base, map->size);
+    }
+
+    if (header)
+    {
+        memcpy(map->base, format == SAMPLE_FORMAT_U16 ? SAMPLE_HEADER_U16 : SAMPLE_HEADER_S16, SAMPLE_HEADER_SIZE);
+    }
+    map->samples = map->base == NULL ? NULL : (uint16_t *)(map->base + headerSize);
+    return 0;
+}
+
+int sampleMapClose(SampleMap *map)
+{
+    int status = 0;
+    if (map->base != NULL && munmap(map->base, map->size) < 0)
+    {
+        status = -1;
+    }
+    if (map->fd >= 0 && close(map->fd) < 0)
+    {
+        status = -1;
+    }
+    map->base = NULL;
+    map->fd = -1;
+    return status;
+}
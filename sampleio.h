@@ -0,0 +1,165 @@
+#ifndef _SAMPLEIO_H_
+#define _SAMPLEIO_H_
+
+/**
+ * @file sampleio.h
+ * @brief Block based reading and writing of sample files
+ * @details Samples are unsigned 16 bit integers. They are stored either as text, one decimal value per line (the `.dat`
+ *          format), as raw little endian 16 bit PCM, or as PCM WAV. Files are read through a fixed size buffer so memory
+ *          use does not depend on the length of the file.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Binary files start with an 8 byte header so they can be told apart from text: "BWPCM" followed by "U16" or "S16".
+    Signed samples are offset by 32768 to map them onto the unsigned range used by the filter.
+*/
+#define SAMPLE_HEADER_SIZE 8
+#define SAMPLE_HEADER_U16 "BWPCMU16"
+#define SAMPLE_HEADER_S16 "BWPCMS16"
+
+typedef enum SampleFormat
+{
+    SAMPLE_FORMAT_AUTO, // Binary if the file starts with a header, otherwise text. Only valid for reading.
+    SAMPLE_FORMAT_TEXT, // One decimal value per line
+    SAMPLE_FORMAT_U16,  // Little endian unsigned 16 bit PCM
+    SAMPLE_FORMAT_S16,  // Little endian signed 16 bit PCM
+    SAMPLE_FORMAT_WAV   // RIFF WAVE, 16, 24 or 32 bit signed PCM with any number of interleaved channels
+} SampleFormat;
+
+/*
+    WAV samples wider than 16 bits are reduced to their top 16 bits when read, the filter works on 16 bit samples.
+    Written samples are widened back by filling the low bits with zeros. Channels stay interleaved in the sample
+    blocks, one frame (a sample from every channel) after the other.
+*/
+#define SAMPLE_MAX_CHANNELS 64
+
+// Channel layout and sample rate of a file, the defaults for formats that do not store them are one channel of
+// 16 bit samples at an unknown (0) rate
+typedef struct SampleLayout
+{
+    unsigned channels;      // Interleaved channels per frame
+    unsigned sampleRate;    // Frames per second, 0 if unknown
+    unsigned bitsPerSample; // Width of a stored sample, 16, 24 or 32
+} SampleLayout;
+
+// Look up a format by its command line name ("auto", "text", "u16", "s16" or "wav"). Returns -1 for unknown names.
+int sampleFormatFromName(const char *name, SampleFormat *format);
+
+// Smallest buffer a reader or writer works with, large enough for any header
+#define SAMPLE_MIN_BUFFER_SIZE 64
+
+// Bytes needed at the start of a file to recognise every header
+#define SAMPLE_PEEK_SIZE 12
+
+// Format named by the header at the start of a file, SAMPLE_FORMAT_TEXT if there is no header
+SampleFormat sampleHeaderFormat(const unsigned char *bytes, size_t len);
+
+// Reader state for a sample file, all fields are managed by the sampleReader* functions
+typedef struct SampleReader
+{
+    int fd;                   // File descriptor being read
+    unsigned char *buffer;    // Raw bytes read from the file
+    size_t capacity;          // Size of the buffer in bytes
+    size_t pos;               // Position of the next unparsed byte in the buffer
+    size_t len;               // Number of valid bytes in the buffer
+    int eof;                  // Set once the file has no more data to read
+    size_t line;              // Line (text) or number (binary) of the next sample, used for error reporting
+    int lineHasSample;        // Set once the current text line holds a sample, a second value on it is malformed
+    SampleFormat format;      // Format of the file, never SAMPLE_FORMAT_AUTO once opened
+    SampleLayout layout;      // Channels and sample rate, from the header of a WAV file
+    size_t dataRemaining;     // Bytes left in the WAV data chunk, SIZE_MAX for other formats
+    int ownsBuffer;           // Set if the buffer was allocated by the reader
+    uint64_t bytesRead;       // Bytes read from the file so far
+    int timed;                // Set by the caller to measure readNanoseconds, for --stats
+    uint64_t readNanoseconds; // Time spent in read() while timed is set
+} SampleReader;
+
+// Open a sample file for reading using a buffer of bufferSize bytes, "-" reads standard input.
+// Returns 0 on success, -1 on failure. With SAMPLE_FORMAT_AUTO the format is taken from the header. A binary format
+// given explicitly also reads files without a header (raw PCM), a header is skipped if present.
+int sampleReaderOpen(SampleReader *reader, const char *path, size_t bufferSize, SampleFormat format);
+
+// Open a sample file like sampleReaderOpen, reading through a buffer owned by the caller that is not freed on close.
+// The buffer must be at least SAMPLE_MIN_BUFFER_SIZE bytes, and hold a whole frame of a WAV file.
+int sampleReaderOpenBuffer(SampleReader *reader, const char *path, unsigned char *buffer, size_t bufferSize, SampleFormat format);
+
+// Parse up to maxSamples samples from the reader. Only blocks for more input when nothing has been parsed yet, so
+// samples arriving through a pipe are handed on as soon as they are read. Multi-channel input is only returned in whole
+// frames, maxSamples must hold at least one frame.
+// Returns the number of samples parsed, 0 at the end of the file, or -1 if the input is malformed.
+// On error reader->line holds the line (or sample) containing the malformed sample.
+long sampleReaderRead(SampleReader *reader, uint16_t *samples, size_t maxSamples);
+
+// Close the file and release the buffer
+void sampleReaderClose(SampleReader *reader);
+
+// Writer state for a sample file, all fields are managed by the sampleWriter* functions
+typedef struct SampleWriter
+{
+    int fd;                    // File descriptor being written
+    char *buffer;              // Formatted samples waiting to be written
+    size_t capacity;           // Size of the buffer in bytes
+    size_t len;                // Number of bytes waiting in the buffer
+    SampleFormat format;       // Format of the file
+    SampleLayout layout;       // Channels and sample rate written to a WAV header
+    uint64_t dataBytes;        // Sample bytes written so far, for the WAV header
+    int ownsBuffer;            // Set if the buffer was allocated by the writer
+    uint64_t bytesWritten;     // Bytes handed to write() so far, header included
+    int timed;                 // Set by the caller to measure writeNanoseconds, for --stats
+    uint64_t writeNanoseconds; // Time spent in write() while timed is set
+} SampleWriter;
+
+// Create (or truncate) a sample file for writing using a buffer of bufferSize bytes, "-" writes standard output.
+// Returns 0 on success, -1 on failure.
+// Binary formats start with a header unless header is 0. layout is only used by WAV, NULL writes one channel of
+// 16 bit samples. The WAV sizes are filled in on close, a pipe gets a header marking the length as unknown.
+int sampleWriterOpen(SampleWriter *writer, const char *path, size_t bufferSize, SampleFormat format, int header,
+                     const SampleLayout *layout);
+
+// Create a sample file like sampleWriterOpen, writing through a buffer owned by the caller that is not freed on close.
+// The buffer must be at least SAMPLE_MIN_BUFFER_SIZE bytes.
+int sampleWriterOpenBuffer(SampleWriter *writer, const char *path, char *buffer, size_t bufferSize, SampleFormat format,
+                           int header, const SampleLayout *layout);
+
+// Format numSamples samples into the output. Returns 0 on success, -1 if the file could not be written.
+int sampleWriterWrite(SampleWriter *writer, const uint16_t *samples, size_t numSamples);
+
+// Write out any buffered text. Returns 0 on success, -1 if the file could not be written.
+int sampleWriterFlush(SampleWriter *writer);
+
+// Flush and close the file and release the buffer. Returns 0 on success, -1 if the final flush failed.
+int sampleWriterClose(SampleWriter *writer);
+
+// Mapping of a binary sample file, all fields are managed by the sampleMap* functions
+// The mapping is page aligned and the header keeps the samples aligned, so they are accessed in place
+typedef struct SampleMap
+{
+    int fd;              // File descriptor of the mapped file
+    unsigned char *base; // Start of the mapping, NULL for an empty file
+    size_t size;         // Length of the mapping in bytes
+    uint16_t *samples;   // First sample, after the header if there is one
+    size_t numSamples;   // Number of samples in the file
+    SampleFormat format; // Format of the samples, never SAMPLE_FORMAT_AUTO or SAMPLE_FORMAT_TEXT
+} SampleMap;
+
+// Map a binary sample file for reading, the format is detected as in sampleReaderOpen.
+// Returns 0 on success, 1 if the file cannot be used in place (text, WAV, or a big endian host), -1 on failure.
+int sampleMapOpen(SampleMap *map, const char *path, SampleFormat format);
+
+// Create (or truncate) a binary sample file sized for numSamples samples and map it for writing.
+// Returns 0 on success, -1 on failure.
+int sampleMapCreate(SampleMap *map, const char *path, SampleFormat format, int header, size_t numSamples);
+
+// Unmap and close the file. Returns 0 on success, -1 if the mapped data could not be written back.
+int sampleMapClose(SampleMap *map);
+
+// Value to xor with a stored sample to convert it to or from the unsigned range used by the filter
+static inline uint16_t sampleFormatOffset(SampleFormat format)
+{
+    return format == SAMPLE_FORMAT_S16 || format == SAMPLE_FORMAT_WAV ? 0x8000 : 0;
+}
+
+#endif // _SAMPLEIO_H_
@@ -0,0 +1,369 @@
+#ifndef _SIMDFILTER_H_
+#define _SIMDFILTER_H_
+
+/**
+ * @file simdfilter.h
+ * @brief AVX2 / AVX-512 biquad kernels filtering 8 or 16 channels at once
+ * @details The state and coefficients of each section are kept as structure of arrays, one vector lane per channel, so
+ *          every instruction advances all the channels of a group by one sample. The arithmetic reproduces
+ *          fixedpoint_mul and fixedpoint_to_uint16 exactly, the output is bit for bit that of the scalar filter.
+ *          Compiled into every x86-64 build for its instruction set with a target attribute, and only called when
+ *          cpuFeatures() reports the instructions, so the binary itself may target the x86-64 baseline.
+ */
+
+/*
+(NOTE: 1):  fixedpoint_mul is (a * b) >> FRACTIONAL_BITS in 64 bits, truncated to 32 bits. vpmuldq multiplies the signed
+            low halves of the 64 bit lanes, so the even and odd 32 bit lanes are multiplied separately. Only bits
+            [FRACTIONAL_BITS, FRACTIONAL_BITS + 32) of each product survive the truncation, and those are the same for a
+            logical and an arithmetic shift, so the shift needs no sign extension (AVX2 has no 64 bit arithmetic shift).
+
+(NOTE: 2):  fixedpoint_div(y, 2.0) divides in 64 bits with C's truncation towards zero, so negative odd values round up.
+            Adding the sign bit before the arithmetic shift gives the same rounding.
+
+(NOTE: 3):  The result is truncated to 16 bits like the uint16_t conversion of the scalar path, not saturated.
+
+(NOTE: 4):  Frames are filtered SIMD_CHUNK at a time: the chunk is converted to fixed point, run through the first section,
+            then the next, and converted back. The chunk of vectors stays in L1 for every section.
+
+(NOTE: 5):  The look-ahead kernel of a single channel computes SIMD_LOOKAHEAD_BLOCK outputs as one matrix product: column c
+            holds the response of every output to input c, products are 32x32 to 64 bits and summed in 64 bits, then
+            shifted down once. Columns are stored as 64 bit lanes so vpmuldq reads them without shuffling.
+
+(NOTE: 6):  The int16 kernel keeps samples, state and coefficients in Q1.15, 16 channels per AVX2 register instead of 8.
+            A product is vpmulhrsw, (a * b + 2^14) >> 15. a1 of a biquad lies in (-2, 2), so it is split into a whole
+            part applied by adding or subtracting y1, shared by the group, and a Q1.15 remainder. The sums wrap like the
+            32 bit sums of the scalar kernel, so a partial sum may leave the range as long as the output is in it (the
+            whole part of a1 often cancels most of the numerator). The output is the Q1.15 result plus a per lane bias.
+            q1_15_mul_round in fixedpoint.h gives the same products one channel at a time.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fixedpoint.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SIMDFILTER_AVX2 1
+#define SIMDFILTER_AVX512 1
+#define SIMDFILTER_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMDFILTER_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#endif
+
+#define SIMD_MAX_LANES 16
+#define SIMD_SECTION_COEFFICIENTS 5 // b0, b1, b2, a1, a2
+#define SIMD_SECTION_STATE 4        // x1, x2, y1, y2
+#define SIMD_CHUNK 64               // Frames run through one section before the next, (NOTE: 4)
+#define SIMD_MAX_SECTIONS 8         // Second order sections of a 16th order filter
+#define SIMD_LOOKAHEAD_BLOCK 16     // Outputs of the look-ahead kernel computed at once, (NOTE: 5)
+#define SIMD_INT16_LANES 16         // Channels of the int16 kernel per AVX2 register, (NOTE: 6)
+
+// Coefficients and state of every section for a group of channels, indexed [section][coefficient or state][lane]
+typedef struct SimdSections
+{
+    int32_t coefficients[SIMD_MAX_SECTIONS][SIMD_SECTION_COEFFICIENTS][SIMD_MAX_LANES];
+    int32_t state[SIMD_MAX_SECTIONS][SIMD_SECTION_STATE][SIMD_MAX_LANES];
+    unsigned numSections;
+} SimdSections;
+
+// Q1.15 coefficients (b0, b1, b2, the remainder of a1, a2) and state of every section for a group of channels, (NOTE: 6)
+typedef struct SimdSectionsInt16
+{
+    int16_t coefficients[SIMD_MAX_SECTIONS][SIMD_SECTION_COEFFICIENTS][SIMD_INT16_LANES];
+    int16_t state[SIMD_MAX_SECTIONS][SIMD_SECTION_STATE][SIMD_INT16_LANES];
+    int wholeA1[SIMD_MAX_SECTIONS]; // Whole part of a1, the same for every lane
+    int16_t outputBias[SIMD_INT16_LANES];
+    unsigned numSections;
+} SimdSectionsInt16;
+
+#ifdef SIMDFILTER_AVX2
+// fixedpoint_mul of every lane, (NOTE: 1)
+SIMDFILTER_TARGET_AVX2
+static inline __m256i simdMul8(__m256i a, __m256i b)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(a, b), FRACTIONAL_BITS);
+    __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    odd = _mm256_slli_epi64(_mm256_srli_epi64(odd, FRACTIONAL_BITS), 32);
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+// Filter 8 channels that are stride samples apart in interleaved frames
+SIMDFILTER_TARGET_AVX2
+static void simdFilter8(SimdSections *sections, const uint16_t *input, uint16_t *output, size_t numFrames, size_t stride,
+                        uint16_t inputOffset, uint16_t outputOffset)
+{
+    __m256i work[SIMD_CHUNK];
+    const __m128i inputXor = _mm_set1_epi16((short)inputOffset);
+    const __m128i outputXor = _mm_set1_epi16((short)outputOffset);
+    const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i middle = _mm256_set1_epi32(fixedpoint_from_int(32767));
+
+    for (size_t start = 0; start < numFrames; start += SIMD_CHUNK)
+    {
+        size_t n = numFrames - start < SIMD_CHUNK ? numFrames - start : SIMD_CHUNK;
+        const uint16_t *in = input + start * stride;
+        uint16_t *out = output + start * stride;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            __m128i samples = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + i * stride)), inputXor);
+            work[i] = _mm256_slli_epi32(_mm256_cvtepu16_epi32(samples), FRACTIONAL_BITS);
+        }
+
+        for (unsigned s = 0; s < sections->numSections; s++)
+        {
+            int32_t(*c)[SIMD_MAX_LANES] = sections->coefficients[s];
+            int32_t(*state)[SIMD_MAX_LANES] = sections->state[s];
+            __m256i b0 = _mm256_loadu_si256((const __m256i *)c[0]);
+            __m256i b1 = _mm256_loadu_si256((const __m256i *)c[1]);
+            __m256i b2 = _mm256_loadu_si256((const __m256i *)c[2]);
+            __m256i a1 = _mm256_loadu_si256((const __m256i *)c[3]);
+            __m256i a2 = _mm256_loadu_si256((const __m256i *)c[4]);
+            __m256i x1 = _mm256_loadu_si256((const __m256i *)state[0]);
+            __m256i x2 = _mm256_loadu_si256((const __m256i *)state[1]);
+            __m256i y1 = _mm256_loadu_si256((const __m256i *)state[2]);
+            __m256i y2 = _mm256_loadu_si256((const __m256i *)state[3]);
+            for (size_t i = 0; i < n; i++)
+            {
+                __m256i x = work[i];
+                __m256i feedForward = _mm256_add_epi32(_mm256_add_epi32(simdMul8(b0, x), simdMul8(b1, x1)), simdMul8(b2, x2));
+                __m256i feedBack = _mm256_add_epi32(simdMul8(a1, y1), simdMul8(a2, y2));
+                __m256i y = _mm256_sub_epi32(feedForward, feedBack);
+                x2 = x1;
+                x1 = x;
+                y2 = y1;
+                y1 = y;
+                work[i] = y;
+            }
+            _mm256_storeu_si256((__m256i *)state[0], x1);
+            _mm256_storeu_si256((__m256i *)state[1], x2);
+            _mm256_storeu_si256((__m256i *)state[2], y1);
+            _mm256_storeu_si256((__m256i *)state[3], y2);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            __m256i y = work[i];
+            __m256i adjusted = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_srli_epi32(y, 31)), 1); // (NOTE: 2)
+            __m256i scaled = _mm256_srai_epi32(_mm256_add_epi32(adjusted, middle), FRACTIONAL_BITS);
+            __m256i packed = _mm256_packus_epi32(_mm256_and_si256(scaled, lowMask), _mm256_setzero_si256()); // (NOTE: 3)
+            packed = _mm256_permute4x64_epi64(packed, 0x08);
+            _mm_storeu_si128((__m128i *)(out + i * stride), _mm_xor_si128(_mm256_castsi256_si128(packed), outputXor));
+        }
+    }
+}
+#endif
+
+#ifdef SIMDFILTER_AVX512
+// fixedpoint_mul of every lane, (NOTE: 1)
+SIMDFILTER_TARGET_AVX512
+static inline __m512i simdMul16(__m512i a, __m512i b)
+{
+    __m512i even = _mm512_srli_epi64(_mm512_mul_epi32(a, b), FRACTIONAL_BITS);
+    __m512i odd = _mm512_mul_epi32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+    odd = _mm512_slli_epi64(_mm512_srli_epi64(odd, FRACTIONAL_BITS), 32);
+    return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+}
+
+// Filter 16 channels that are stride samples apart in interleaved frames
+SIMDFILTER_TARGET_AVX512
+static void simdFilter16(SimdSections *sections, const uint16_t *input, uint16_t *output, size_t numFrames, size_t stride,
+                         uint16_t inputOffset, uint16_t outputOffset)
+{
+    __m512i work[SIMD_CHUNK];
+    const __m256i inputXor = _mm256_set1_epi16((short)inputOffset);
+    const __m256i outputXor = _mm256_set1_epi16((short)outputOffset);
+    const __m512i middle = _mm512_set1_epi32(fixedpoint_from_int(32767));
+
+    for (size_t start = 0; start < numFrames; start += SIMD_CHUNK)
+    {
+        size_t n = numFrames - start < SIMD_CHUNK ? numFrames - start : SIMD_CHUNK;
+        const uint16_t *in = input + start * stride;
+        uint16_t *out = output + start * stride;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            __m256i samples = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + i * stride)), inputXor);
+            work[i] = _mm512_slli_epi32(_mm512_cvtepu16_epi32(samples), FRACTIONAL_BITS);
+        }
+
+        for (unsigned s = 0; s < sections->numSections; s++)
+        {
+            int32_t(*c)[SIMD_MAX_LANES] = sections->coefficients[s];
+            int32_t(*state)[SIMD_MAX_LANES] = sections->state[s];
+            __m512i b0 = _mm512_loadu_si512(c[0]);
+            __m512i b1 = _mm512_loadu_si512(c[1]);
+            __m512i b2 = _mm512_loadu_si512(c[2]);
+            __m512i a1 = _mm512_loadu_si512(c[3]);
+            __m512i a2 = _mm512_loadu_si512(c[4]);
+            __m512i x1 = _mm512_loadu_si512(state[0]);
+            __m512i x2 = _mm512_loadu_si512(state[1]);
+            __m512i y1 = _mm512_loadu_si512(state[2]);
+            __m512i y2 = _mm512_loadu_si512(state[3]);
+            for (size_t i = 0; i < n; i++)
+            {
+                __m512i x = work[i];
+                __m512i feedForward = _mm512_add_epi32(_mm512_add_epi32(simdMul16(b0, x), simdMul16(b1, x1)), simdMul16(b2, x2));
+                __m512i feedBack = _mm512_add_epi32(simdMul16(a1, y1), simdMul16(a2, y2));
+                __m512i y = _mm512_sub_epi32(feedForward, feedBack);
+                x2 = x1;
+                x1 = x;
+                y2 = y1;
+                y1 = y;
+                work[i] = y;
+            }
+            _mm512_storeu_si512(state[0], x1);
+            _mm512_storeu_si512(state[1], x2);
+            _mm512_storeu_si512(state[2], y1);
+            _mm512_storeu_si512(state[3], y2);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            __m512i y = work[i];
+            __m512i adjusted = _mm512_srai_epi32(_mm512_add_epi32(y, _mm512_srli_epi32(y, 31)), 1); // (NOTE: 2)
+            __m512i scaled = _mm512_srai_epi32(_mm512_add_epi32(adjusted, middle), FRACTIONAL_BITS);
+            __m256i samples = _mm512_cvtepi32_epi16(scaled); // Truncating, (NOTE: 3)
+            _mm256_storeu_si256((__m256i *)(out + i * stride), _mm256_xor_si256(samples, outputXor));
+        }
+    }
+}
+#endif
+
+#ifdef SIMDFILTER_AVX512
+// outputs[j] = (sum of columns[c][j] * inputs[c]) >> shift for the SIMD_LOOKAHEAD_BLOCK outputs, (NOTE: 5)
+// The first SIMD_LOOKAHEAD_BLOCK columns are the block's inputs, an input has no effect on the outputs before it, so
+// inputs from the ninth on skip the lower 8 rows.
+SIMDFILTER_TARGET_AVX512
+static void simdLookahead16(const int64_t (*columns)[SIMD_LOOKAHEAD_BLOCK], const int32_t *inputs, unsigned numColumns, unsigned shift,
+                            int32_t *outputs)
+{
+    __m512i low = _mm512_setzero_si512();
+    __m512i high = _mm512_setzero_si512();
+    for (unsigned c = 0; c < numColumns; c++)
+    {
+        __m512i input = _mm512_set1_epi64(inputs[c]);
+        if (c < 8 || c >= SIMD_LOOKAHEAD_BLOCK)
+        {
+            low = _mm512_add_epi64(low, _mm512_mul_epi32(_mm512_loadu_si512(columns[c]), input));
+        }
+        high = _mm512_add_epi64(high, _mm512_mul_epi32(_mm512_loadu_si512(columns[c] + 8), input));
+    }
+    __m128i count = _mm_cvtsi32_si128((int)shift);
+    _mm256_storeu_si256((__m256i *)outputs, _mm512_cvtepi64_epi32(_mm512_sra_epi64(low, count)));
+    _mm256_storeu_si256((__m256i *)(outputs + 8), _mm512_cvtepi64_epi32(_mm512_sra_epi64(high, count)));
+}
+#endif
+
+#ifdef SIMDFILTER_AVX2
+// simdLookahead16 with AVX2, four rows of 64 bit sums per register. An input from the fifth on skips the rows of the
+// registers before it. Only the low 32 bits of a shifted sum are kept, so a logical shift will do, (NOTE: 1).
+SIMDFILTER_TARGET_AVX2
+static void simdLookaheadAvx2(const int64_t (*columns)[SIMD_LOOKAHEAD_BLOCK], const int32_t *inputs, unsigned numColumns, unsigned shift,
+                              int32_t *outputs)
+{
+    __m256i rows0 = _mm256_setzero_si256();
+    __m256i rows4 = _mm256_setzero_si256();
+    __m256i rows8 = _mm256_setzero_si256();
+    __m256i rows12 = _mm256_setzero_si256();
+    for (unsigned c = 0; c < numColumns; c++)
+    {
+        __m256i input = _mm256_set1_epi64x(inputs[c]);
+        unsigned first = c < SIMD_LOOKAHEAD_BLOCK ? c : 0;
+        if (first < 4)
+        {
+            rows0 = _mm256_add_epi64(rows0, _mm256_mul_epi32(_mm256_loadu_si256((const __m256i *)columns[c]), input));
+        }
+        if (first < 8)
+        {
+            rows4 = _mm256_add_epi64(rows4, _mm256_mul_epi32(_mm256_loadu_si256((const __m256i *)(columns[c] + 4)), input));
+        }
+        if (first < 12)
+        {
+            rows8 = _mm256_add_epi64(rows8, _mm256_mul_epi32(_mm256_loadu_si256((const __m256i *)(columns[c] + 8)), input));
+        }
+        rows12 = _mm256_add_epi64(rows12, _mm256_mul_epi32(_mm256_loadu_si256((const __m256i *)(columns[c] + 12)), input));
+    }
+    __m128i count = _mm_cvtsi32_si128((int)shift);
+    const __m256i lowHalves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i low = _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(_mm256_srl_epi64(rows0, count), lowHalves),
+                                            _mm256_permutevar8x32_epi32(_mm256_srl_epi64(rows4, count), lowHalves), 0x20);
+    __m256i high = _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(_mm256_srl_epi64(rows8, count), lowHalves),
+                                             _mm256_permutevar8x32_epi32(_mm256_srl_epi64(rows12, count), lowHalves), 0x20);
+    _mm256_storeu_si256((__m256i *)outputs, low);
+    _mm256_storeu_si256((__m256i *)(outputs + 8), high);
+}
+#endif
+
+#ifdef SIMDFILTER_AVX2
+// Filter 16 channels that are stride samples apart in interleaved frames in Q1.15, (NOTE: 6). An input is the sample
+// centered on zero and halved, an output the filtered value plus the lane's bias.
+SIMDFILTER_TARGET_AVX2
+static void simdFilterInt16(SimdSectionsInt16 *sections, const uint16_t *input, uint16_t *output, size_t numFrames, size_t stride)
+{
+    __m256i work[SIMD_CHUNK];
+    const __m256i center = _mm256_set1_epi16((short)0x8000);
+    const __m256i bias = _mm256_loadu_si256((const __m256i *)sections->outputBias);
+
+    for (size_t start = 0; start < numFrames; start += SIMD_CHUNK)
+    {
+        size_t n = numFrames - start < SIMD_CHUNK ? numFrames - start : SIMD_CHUNK;
+        const uint16_t *in = input + start * stride;
+        uint16_t *out = output + start * stride;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            work[i] = _mm256_srai_epi16(_mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(in + i * stride)), center), 1);
+        }
+
+        for (unsigned s = 0; s < sections->numSections; s++)
+        {
+            int16_t(*c)[SIMD_INT16_LANES] = sections->coefficients[s];
+            int16_t(*state)[SIMD_INT16_LANES] = sections->state[s];
+            int wholeA1 = sections->wholeA1[s];
+            __m256i b0 = _mm256_loadu_si256((const __m256i *)c[0]);
+            __m256i b1 = _mm256_loadu_si256((const __m256i *)c[1]);
+            __m256i b2 = _mm256_loadu_si256((const __m256i *)c[2]);
+            __m256i a1 = _mm256_loadu_si256((const __m256i *)c[3]);
+            __m256i a2 = _mm256_loadu_si256((const __m256i *)c[4]);
+            __m256i x1 = _mm256_loadu_si256((const __m256i *)state[0]);
+            __m256i x2 = _mm256_loadu_si256((const __m256i *)state[1]);
+            __m256i y1 = _mm256_loadu_si256((const __m256i *)state[2]);
+            __m256i y2 = _mm256_loadu_si256((const __m256i *)state[3]);
+            for (size_t i = 0; i < n; i++)
+            {
+                __m256i x = work[i];
+                __m256i y = _mm256_mulhrs_epi16(b0, x);
+                y = _mm256_add_epi16(y, _mm256_mulhrs_epi16(b1, x1));
+                y = _mm256_add_epi16(y, _mm256_mulhrs_epi16(b2, x2));
+                y = _mm256_sub_epi16(y, _mm256_mulhrs_epi16(a1, y1));
+                y = _mm256_sub_epi16(y, _mm256_mulhrs_epi16(a2, y2));
+                for (int k = 0; k < wholeA1; k++)
+                {
+                    y = _mm256_sub_epi16(y, y1);
+                }
+                for (int k = 0; k > wholeA1; k--)
+                {
+                    y = _mm256_add_epi16(y, y1);
+                }
+                x2 = x1;
+                x1 = x;
+                y2 = y1;
+                y1 = y;
+                work[i] = y;
+            }
+            _mm256_storeu_si256((__m256i *)state[0], x1);
+            _mm256_storeu_si256((__m256i *)state[1], x2);
+            _mm256_storeu_si256((__m256i *)state[2], y1);
+            _mm256_storeu_si256((__m256i *)state[3], y2);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            _mm256_storeu_si256((__m256i *)(out + i * stride), _mm256_add_epi16(work[i], bias));
+        }
+    }
+}
+#endif
+
+#endif // _SIMDFILTER_H_
@@ -0,0 +1,18 @@
+/**
+ * @file specialized.h
+ * @brief Filter design compiled into the specialized kernel of butterworth.c
+ * @details Generated by butterworth --emit-kernel -r 22000 -c 2000 -n 2, regenerate with make specialize.
+ *          Q17.15 coefficients of every section, SECTION(index, b0, b1, b2, a1, a2).
+ */
+
+#ifndef _SPECIALIZED_H_
+#define _SPECIALIZED_H_
+
+#define SPECIALIZED_SAMPLING_RATE 22000
+#define SPECIALIZED_CUTOFF_FREQUENCY 2000
+#define SPECIALIZED_ORDER 2
+
+#define SPECIALIZED_SECTIONS(SECTION) \
+    SECTION(0, 1881, 3762, 1881, -39873, 14638)
+
+#endif // _SPECIALIZED_H_
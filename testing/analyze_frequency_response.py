@@ -31,8 +31,8 @@ def main():
         description="Analyze filter with optional arguments.")
     parser.add_argument("input_samples", type=str,
                         help="Path to unmodified sample data")
-    parser.add_argument("filtered_samples", type=str,
-                        help="Path to filtered sample data")
+    parser.add_argument("filtered_samples", type=str, nargs='?', default="",
+                        help="Path to filtered sample data (default: filter in-process with libbutterworth, see make lib)")
     parser.add_argument("--frequency-cutoff", type=int,
                         default=2000, help="Frequency for -3db (default: 2_000)")
     parser.add_argument("--sample-rate", type=int,
@@ -56,8 +56,13 @@ def main():
     # Read in impulse signal
     unfiltered_samples = np.fromfile(
         args.input_samples, dtype=np.uint16, sep='\n')
-    filtered_samples = np.fromfile(
-        args.filtered_samples, dtype=np.uint16, sep='\n')
+    if (args.filtered_samples == ""):
+        import pybutterworth
+        filtered_samples = pybutterworth.butterworth_filter(
+            unfiltered_samples, cutoff_freq=CUTOFF_FREQUENCY, sampling_rate=SAMPLING_FREQUENCY)
+    else:
+        filtered_samples = np.fromfile(
+            args.filtered_samples, dtype=np.uint16, sep='\n')
 
     # Adjust for the rezeroing of the signal
     filtered_samples = (filtered_samples.astype(np.int32) - 32768) * 2
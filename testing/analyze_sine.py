@@ -28,8 +28,8 @@ def main():
         description="Analyze filter with optional arguments.")
     parser.add_argument("input_samples", type=str,
                         help="Path to unmodified sample data")
-    parser.add_argument("filtered_samples", type=str,
-                        help="Path to filtered sample data")
+    parser.add_argument("filtered_samples", type=str, nargs='?', default="",
+                        help="Path to filtered sample data (default: filter in-process with libbutterworth, see make lib)")
     parser.add_argument("--frequency-cutoff", type=int,
                         default=2000, help="Frequency for -3db (default: 2_000)")
     parser.add_argument("--sample-rate", type=int,
@@ -47,8 +47,13 @@ def main():
 
     # Filtered sine wave signal:
 
-    filtered_sine_wave = np.fromfile(
-        args.filtered_samples, dtype=np.uint16, sep='\n')
+    if (args.filtered_samples == ""):
+        import pybutterworth
+        filtered_sine_wave = pybutterworth.butterworth_filter(
+            sine_wave, cutoff_freq=CUTOFF_FREQUENCY, sampling_rate=SAMPLING_FREQUENCY)
+    else:
+        filtered_sine_wave = np.fromfile(
+            args.filtered_samples, dtype=np.uint16, sep='\n')
 
     # Adjust for the rezeroing of the signal:
     filtered_sine_wave = (filtered_sine_wave.astype(np.int32) - 32768) * 2
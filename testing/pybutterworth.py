@@ -0,0 +1,114 @@
+"""NumPy bindings of libbutterworth.h, the fixed point filter of the butterworth tool, through ctypes.
+
+Build the library first with `make lib`. Arrays are passed to C by pointer through the buffer protocol, so the
+samples are never copied or converted in Python: uint16 arrays are filtered like `butterworth -i u16 -o u16`, and
+int32 arrays hold Q17.15 fixed point samples (a 16 bit sample s is s << 15), filtered in place by the same cascade.
+"""
+import ctypes
+import os
+
+import numpy as np
+
+# Path of the shared library, the repository root by default
+LIBRARY_PATH = os.environ.get('LIBBUTTERWORTH_PATH', os.path.join(
+    os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'libbutterworth.so'))
+FRACTIONAL_BITS = 15  # Q17.15, see fixedpoint.h
+
+_library = None
+
+
+def _load():
+    global _library
+    if _library is None:
+        library = ctypes.CDLL(LIBRARY_PATH)
+        library.butterworthCreate.restype = ctypes.c_void_p
+        library.butterworthCreate.argtypes = [ctypes.c_double, ctypes.c_double, ctypes.c_uint]
+        library.butterworthProcessBlock.restype = None
+        library.butterworthProcessBlock.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+        library.butterworthProcessFixed.restype = None
+        library.butterworthProcessFixed.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+        library.butterworthReset.restype = None
+        library.butterworthReset.argtypes = [ctypes.c_void_p]
+        library.butterworthDestroy.restype = None
+        library.butterworthDestroy.argtypes = [ctypes.c_void_p]
+        _library = library
+    return _library
+
+
+def _buffer(samples, writable):
+    # A view of the caller's memory, refused rather than copied when it is not one contiguous uint16 or int32 block
+    array = np.asarray(samples)
+    if array.dtype not in (np.uint16, np.int32):
+        raise TypeError(f'Expected uint16 or int32 samples but found {array.dtype}')
+    if not array.flags.c_contiguous:
+        raise ValueError('Samples must be contiguous')
+    if writable and not array.flags.writeable:
+        raise ValueError('Output samples must be writable')
+    return array
+
+
+class Butterworth:
+    """Low-pass filter of one channel that keeps its state from one call of process to the next."""
+
+    def __init__(self, sampling_rate=22000, cutoff_freq=2000, order=2):
+        self._library = _load()
+        self._handle = self._library.butterworthCreate(sampling_rate, cutoff_freq, order)
+        if not self._handle:
+            raise ValueError(f'A cutoff of {cutoff_freq} Hz at {sampling_rate} Hz and order {order} can not be represented')
+
+    def process(self, samples, out=None):
+        """Filter a block of uint16 or int32 samples into out, a new array of the same type by default.
+
+        Pass out=samples to filter in place. The C filter reads and writes the arrays directly.
+        """
+        samples = _buffer(samples, False)
+        if out is None:
+            out = np.empty_like(samples)
+        out = _buffer(out, True)
+        if out.dtype != samples.dtype or out.size != samples.size:
+            raise ValueError(f'Expected {samples.size} {samples.dtype} output samples but found {out.size} {out.dtype}')
+        if samples.dtype == np.uint16:
+            self._library.butterworthProcessBlock(self._handle, samples.ctypes.data, out.ctypes.data, samples.size)
+        else:
+            if out is not samples:
+                np.copyto(out, samples)  # The fixed point cascade only runs in place
+            self._library.butterworthProcessFixed(self._handle, out.ctypes.data, out.size)
+        return out
+
+    def reset(self):
+        """Clear the state, the next block starts a new stream."""
+        self._library.butterworthReset(self._handle)
+
+    def close(self):
+        if self._handle:
+            self._library.butterworthDestroy(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self.close()
+
+
+def butterworth_filter(signal_data, cutoff_freq=2000, sampling_rate=22000, order=2):
+    """Filter a whole signal with the fixed point filter, the in-process counterpart of running the butterworth tool."""
+    with Butterworth(sampling_rate, cutoff_freq, order) as f:
+        return f.process(signal_data)
+
+
+def to_fixed(samples):
+    """16 bit samples as the Q17.15 input of the fixed point cascade."""
+    return np.asarray(samples).astype(np.int32) << FRACTIONAL_BITS
+
+
+def from_fixed(samples):
+    """Q17.15 outputs of the fixed point cascade as the uint16 samples butterworthProcessBlock returns, see
+    fixedpoint_to_uint16 in butterworth.c."""
+    wide = np.asarray(samples).astype(np.int64) << FRACTIONAL_BITS
+    halved = np.sign(wide) * (np.abs(wide) // (2 << FRACTIONAL_BITS))  # fixedpoint_div truncates towards zero
+    return (((halved + (32767 << FRACTIONAL_BITS)).astype(np.int32) >> FRACTIONAL_BITS) & 0xFFFF).astype(np.uint16)
@@ -0,0 +1,405 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall()
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uringio.h"
+
+/*
+(NOTE: 1):  The submission and completion queues are shared with the kernel through mmap. The application owns the
+            submission tail and the completion head, the kernel owns the other two. Counters written by the other side
+            are read with acquire loads and our own counters are published with release stores.
+
+(NOTE: 2):  Each buffer slot moves FREE -> READING -> READY -> (processed) FREE for input, and FREE -> WRITING -> FREE
+            for output. A chunk can only be processed once the previous chunk has been, so completed reads may wait in
+            READY while earlier chunks are still arriving.
+
+(NOTE: 3):  Buffers are registered with the kernel when possible (READ_FIXED / WRITE_FIXED) to skip pinning the pages
+            on every request. Registration can fail under a low RLIMIT_MEMLOCK, plain READ / WRITE are used then.
+*/
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define URINGIO_AVAILABLE 1
+#endif
+#endif
+#endif
+
+#ifdef URINGIO_AVAILABLE
+
+#define BUFFER_ALIGNMENT 4096
+
+typedef struct Uring
+{
+    int fd;
+    // Submission queue, (NOTE: 1)
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned queued; // Entries added since the last submit
+    // Completion queue
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+    // Mappings to release on teardown
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+} Uring;
+
+typedef enum SlotState
+{
+    SLOT_FREE,
+    SLOT_READING,
+    SLOT_READY,
+    SLOT_WRITING
+} SlotState;
+
+// A buffer and the request it is used for, (NOTE: 2)
+typedef struct UringSlot
+{
+    unsigned char *buffer;
+    SlotState state;
+    size_t chunk;     // Chunk of the file held by the buffer
+    size_t length;    // Bytes in the chunk
+    size_t done;      // Bytes transferred so far
+    size_t requested; // Bytes of the request currently in flight
+} UringSlot;
+
+static void uringTeardown(Uring *ring)
+{
+    if (ring->sqes != NULL)
+    {
+        munmap(ring->sqes, ring->sqesSize);
+    }
+    if (ring->cqRing != NULL)
+    {
+        munmap(ring->cqRing, ring->cqRingSize);
+    }
+    if (ring->sqRing != NULL)
+    {
+        munmap(ring->sqRing, ring->sqRingSize);
+    }
+    if (ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+}
+
+static int uringSetup(Uring *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+    {
+        return -1;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    void *sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    void *cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    ring->sqRing = sqRing == MAP_FAILED ? NULL : sqRing;
+    ring->cqRing = cqRing == MAP_FAILED ? NULL : cqRing;
+    ring->sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe *)sqes;
+    if (ring->sqRing == NULL || ring->cqRing == NULL || ring->sqes == NULL)
+    {
+        uringTeardown(ring);
+        return -1;
+    }
+
+    unsigned char *sq = (unsigned char *)ring->sqRing;
+    unsigned char *cq = (unsigned char *)ring->cqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Add a read or write of one slot to the submission queue, the ring is sized so it never fills up
+static void uringQueue(Uring *ring, int opcode, int fd, UringSlot *slot, unsigned index, off_t offset, int fixed)
+{
+    unsigned tail = *ring->sqTail;
+    unsigned entry = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[entry];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)opcode;
+    sqe->fd = fd;
+    sqe->off = (unsigned long long)(offset + (off_t)slot->done);
+    sqe->addr = (unsigned long long)(uintptr_t)(slot->buffer + slot->done);
+    sqe->len = (unsigned)(slot->length - slot->done);
+    sqe->buf_index = fixed ? (unsigned short)index : 0;
+    sqe->user_data = index;
+    slot->requested = slot->length - slot->done;
+
+    ring->sqArray[entry] = entry;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+}
+
+// Monotonic timestamp in nanoseconds
+static uint64_t uringNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Submit everything queued and wait for at least waitFor completions
+static int uringSubmit(Uring *ring, unsigned waitFor)
+{
+    for (;;)
+    {
+        long result = syscall(__NR_io_uring_enter, ring->fd, ring->queued, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result < 0)
+        {
+            return -1;
+        }
+        ring->queued -= (unsigned)result;
+        if (ring->queued == 0)
+        {
+            return 0;
+        }
+    }
+}
+
+int uringTransform(int inFd, off_t inOffset, size_t inBytes, int outFd, off_t outOffset, size_t chunkSize,
+                   unsigned queueDepth, UringChunkFunction process, void *context, UringStats *stats)
+{
+    int timed = stats->timed;
+    memset(stats, 0, sizeof(*stats));
+    stats->timed = timed;
+    stats->queueDepth = queueDepth;
+
+    // Each slot has at most one request in flight, so twice the depth always fits in the ring
+    Uring ring;
+    unsigned numSlots = 2 * queueDepth;
+    if (queueDepth == 0 || uringSetup(&ring, numSlots) < 0)
+    {
+        return 1;
+    }
+
+    // Slots [0, queueDepth) hold input chunks and [queueDepth, numSlots) hold output chunks
+    UringSlot *slots = (UringSlot *)calloc(numSlots, sizeof(UringSlot));
+    struct iovec *iovecs = (struct iovec *)calloc(numSlots, sizeof(struct iovec));
+    int status = (slots == NULL || iovecs == NULL) ? -1 : 0;
+    for (unsigned i = 0; status == 0 && i < numSlots; i++)
+    {
+        void *buffer;
+        if (posix_memalign(&buffer, BUFFER_ALIGNMENT, chunkSize) != 0)
+        {
+            status = -1;
+            break;
+        }
+        slots[i].buffer = (unsigned char *)buffer;
+        iovecs[i].iov_base = buffer;
+        iovecs[i].iov_len = chunkSize;
+    }
+
+    // (NOTE: 3)
+    int fixed = status == 0 && syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, iovecs, numSlots) == 0;
+    int readOp = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    int writeOp = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    stats->fixedBuffers = fixed;
+
+    size_t numChunks = (inBytes + chunkSize - 1) / chunkSize;
+    size_t nextRead = 0;    // Next chunk to start reading
+    size_t nextProcess = 0; // Next chunk to pass to process
+    unsigned inFlight = 0;
+    size_t bytesInFlight = 0;
+    size_t completions = 0;
+    double bytesInFlightSum = 0.0;
+
+    while (status == 0 && (nextProcess < numChunks || inFlight > 0))
+    {
+        // Start reading into every free input buffer
+        for (unsigned i = 0; i < queueDepth && nextRead < numChunks; i++)
+        {
+            if (slots[i].state == SLOT_FREE)
+            {
+                UringSlot *slot = &slots[i];
+                size_t start = nextRead * chunkSize;
+                slot->state = SLOT_READING;
+                slot->chunk = nextRead++;
+                slot->length = inBytes - start < chunkSize ? inBytes - start : chunkSize;
+                slot->done = 0;
+                uringQueue(&ring, readOp, inFd, slot, i, inOffset + (off_t)start, fixed);
+                stats->reads++;
+                inFlight++;
+                bytesInFlight += slot->requested;
+            }
+        }
+
+        // Process chunks in file order while there are output buffers to write them from
+        int progress = 1;
+        int waitingOnWrite = 1; // Until a chunk is found that has not been read yet
+        while (progress && nextProcess < numChunks)
+        {
+            progress = 0;
+            UringSlot *input = NULL;
+            UringSlot *output = NULL;
+            unsigned outputIndex = 0;
+            for (unsigned i = 0; i < queueDepth; i++)
+            {
+                if (slots[i].state == SLOT_READY && slots[i].chunk == nextProcess)
+                {
+                    input = &slots[i];
+                }
+                if (slots[queueDepth + i].state == SLOT_FREE && output == NULL)
+                {
+                    output = &slots[queueDepth + i];
+                    outputIndex = queueDepth + i;
+                }
+            }
+
+            waitingOnWrite = input != NULL;
+            if (input != NULL && output != NULL)
+            {
+                process(context, input->buffer, output->buffer, input->length);
+                output->state = SLOT_WRITING;
+                output->chunk = input->chunk;
+                output->length = input->length;
+                output->done = 0;
+                uringQueue(&ring, writeOp, outFd, output, outputIndex, outOffset + (off_t)(output->chunk * chunkSize), fixed);
+                stats->writes++;
+                inFlight++;
+                bytesInFlight += output->requested;
+
+                input->state = SLOT_FREE;
+                nextProcess++;
+                progress = 1;
+            }
+        }
+
+        if (inFlight > stats->peakRequests)
+        {
+            stats->peakRequests = inFlight;
+        }
+        if (bytesInFlight > stats->peakBytes)
+        {
+            stats->peakBytes = bytesInFlight;
+        }
+
+        // Hand everything to the kernel, only block if there is nothing else to do
+        uint64_t waitStart = timed && inFlight > 0 ? uringNow() : 0;
+        if (uringSubmit(&ring, inFlight > 0 ? 1 : 0) < 0)
+        {
+            status = -1;
+            break;
+        }
+        if (timed && inFlight > 0)
+        {
+            *(waitingOnWrite ? &stats->writeWaitNanoseconds : &stats->readWaitNanoseconds) += uringNow() - waitStart;
+        }
+
+        // Reap completions, (NOTE: 1)
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe *cqe = &ring.cqes[head & ring.cqMask];
+            unsigned index = (unsigned)cqe->user_data;
+            UringSlot *slot = &slots[index];
+
+            bytesInFlightSum += (double)bytesInFlight;
+            completions++;
+            inFlight--;
+            bytesInFlight -= slot->requested;
+
+            if (cqe->res <= 0)
+            {
+                // A zero length read means the file is shorter than expected
+                errno = cqe->res < 0 ? -cqe->res : EIO;
+                status = -1;
+                continue;
+            }
+
+            slot->done += (size_t)cqe->res;
+            if (slot->done < slot->length)
+            {
+                // Short transfer, request the rest
+                int reading = slot->state == SLOT_READING;
+                off_t base = reading ? inOffset : outOffset;
+                uringQueue(&ring, reading ? readOp : writeOp, reading ? inFd : outFd, slot, index,
+                           base + (off_t)(slot->chunk * chunkSize), fixed);
+                if (reading)
+                {
+                    stats->reads++;
+                }
+                else
+                {
+                    stats->writes++;
+                }
+                inFlight++;
+                bytesInFlight += slot->requested;
+            }
+            else
+            {
+                slot->state = slot->state == SLOT_READING ? SLOT_READY : SLOT_FREE;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // Requests still in flight after an error reference the buffers, closing the ring cancels them first
+    stats->averageBytes = completions > 0 ? bytesInFlightSum / (double)completions : 0.0;
+    uringTeardown(&ring);
+    for (unsigned i = 0; slots != NULL && i < numSlots; i++)
+    {
+        free(slots[i].buffer);
+    }
+    free(slots);
+    free(iovecs);
+    return status;
+}
+
+#else
+
+int uringTransform(int inFd, off_t inOffset, size_t inBytes, int outFd, off_t outOffset, size_t chunkSize,
+                   unsigned queueDepth, UringChunkFunction process, void *context, UringStats *stats)
+{
+    (void)inFd;
+    (void)inOffset;
+    (void)inBytes;
+    (void)outFd;
+    (void)outOffset;
+    (void)chunkSize;
+    (void)queueDepth;
+    (void)process;
+    (void)context;
+    memset(stats, 0, sizeof(*stats));
+    return 1;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _URINGIO_H_
+#define _URINGIO_H_
+
+/**
+ * @file uringio.h
+ * @brief Asynchronous chunked file transformation using Linux io_uring
+ * @details A file is read in chunks with several reads kept in flight, each chunk is handed to a callback in file order,
+ *          and the result is written back with several writes kept in flight. The processing thread only waits on the
+ *          disk when every buffer is busy. Talks to the kernel directly, no liburing is needed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Transform one chunk. Chunks are passed in file order, in and out are aligned to at least 16 bytes.
+typedef void (*UringChunkFunction)(void *context, const unsigned char *in, unsigned char *out, size_t bytes);
+
+// Counters describing how deep the queue actually ran, for tuning the depth and chunk size
+typedef struct UringStats
+{
+    int timed;                      // Set by the caller to measure the wait times, for --stats
+    uint64_t readWaitNanoseconds;   // Time blocked in the kernel waiting for the next chunk to be read
+    uint64_t writeWaitNanoseconds;  // Time blocked in the kernel waiting for an output buffer to be written
+    unsigned queueDepth;            // Reads (and writes) allowed in flight at once
+    int fixedBuffers;               // Set if the buffers were registered with the kernel
+    size_t reads;                   // Read requests submitted, including resubmitted short reads
+    size_t writes;                  // Write requests submitted, including resubmitted short writes
+    unsigned peakRequests;          // Most requests in flight at once
+    size_t peakBytes;               // Most bytes in flight at once
+    double averageBytes;            // Bytes in flight averaged over every completion
+} UringStats;
+
+// Read inBytes bytes from inFd starting at inOffset, pass them through process chunkSize bytes at a time and write the
+// result to outFd starting at outOffset. chunkSize must be even and the output of a chunk is the same size as its input.
+// Every field of stats but timed is filled in. Returns 0 on success, 1 if io_uring is not available on this system
+// (nothing has been read or written), or -1 on an I/O error.
+int uringTransform(int inFd, off_t inOffset, size_t inBytes, int outFd, off_t outOffset, size_t chunkSize,
+                   unsigned queueDepth, UringChunkFunction process, void *context, UringStats *stats);
+
+#endif // _URINGIO_H_